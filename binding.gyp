@@ -8,12 +8,37 @@
 
   'targets': [{
     'sources': [
+      'src/AddonState.h',
+      'src/AddonState.cc',
+      'src/Arena.h',
+      'src/Arena.cc',
       'src/binding.cc',
+      'src/Cancellation.h',
+      'src/Cancellation.cc',
       'src/Common.h',
+      'src/ColumnarTable.h',
+      'src/ColumnarTable.cc',
+      'src/Completion.h',
+      'src/Completion.cc',
       'src/Connection.h',
       'src/Connection.cc',
+      'src/ConnectionPool.h',
+      'src/ConnectionPool.cc',
       'src/Function.h',
       'src/Function.cc',
+      'src/FunctionPlan.h',
+      'src/FunctionPlan.cc',
+      'src/MetadataCache.h',
+      'src/MetadataCache.cc',
+      'src/NativeValue.h',
+      'src/NativeValue.cc',
+      'src/ObjectWrap.h',
+      'src/TableCursor.h',
+      'src/TableCursor.cc',
+      'src/Unicode.h',
+      'src/Unicode.cc',
+      'src/WorkerPool.h',
+      'src/WorkerPool.cc',
     ],
 
     'target_name': '<(module_name)',
@@ -30,6 +55,7 @@
       'SAPwithUNICODE',
       'SAPwithTHREADS',
       'NDEBUG',
+      'NAPI_VERSION=6',
     ],
 
     'conditions': [
@@ -57,7 +83,6 @@
            }]
         ],
         'include_dirs': [
-          '<!(node -e "require(\'nan\')")',
           '<(nwrfcsdk_path)/include'
         ],
         'msvs_configuration_attributes': {
@@ -123,7 +148,6 @@
           '-pedantic'
         ],
         'include_dirs': [
-          '<!(node -e "require(\'nan\')")',
           '<(nwrfcsdk_path)/include'
         ],
         'defines': [
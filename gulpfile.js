@@ -5,23 +5,13 @@ var exec = require('child_process').exec;
 var runSequence = require('run-sequence');
 var path = require('path');
 
-var nodeVersions = ['4.0.0', '4.1.2', '4.2.1', '5.0.0'];
+// N-API binaries run on every later version, so the oldest supported one builds them
+var nodeVersions = ['10.20.0'];
 
 var TaskBuilder = function (version) {
   var sourceFile = path.join('build', 'Release', 'sapnwrfc.node');
-  var targetPathParts = {
-    cwd: process.cwd(),
-    compiled: process.env.NODE_BINDINGS_COMPILED_DIR || 'compiled',
-    version: version.match(/^[0-9]+.[0-9]+/)[0] || '',
-    platform: process.platform,
-    arch: process.arch
-  };
-
-  var targetPathArray = [];
-  for (var item in targetPathParts) {
-    targetPathArray.push(targetPathParts[item]);
-  }
-  var targetPath = path.join.apply(null, targetPathArray);
+  var targetPath = path.join(process.cwd(), process.env.NODE_BINDINGS_COMPILED_DIR || 'compiled',
+    'napi-v6', process.platform, process.arch);
 
   return function (cb) {
     var opts = {};
@@ -21,9 +21,8 @@ var rebuild = function () {
   };
 
   try {
-    var majMinVersion = process.versions.node.match(/^[0-9]+.[0-9]+/)[0] || '';
-    var bindings = require('bindings')({ bindings: 'sapnwrfc', version: majMinVersion });
-    console.log(green + 'ok ' + reset + 'found precompiled module at ' + bindings.path);
+    require('./sapnwrfc');
+    console.log(green + 'ok ' + reset + 'found precompiled module for N-API 6');
   } catch (e) {
     console.log(e);
     console.log(red + 'error ' + reset + 'a precompiled module could not be found or loaded');
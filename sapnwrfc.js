@@ -1,2 +1,79 @@
-var majMinVersion = process.versions.node.match(/^[0-9]+.[0-9]+/)[0] || '';
-module.exports = require('bindings')({ bindings: 'sapnwrfc', version: majMinVersion });
\ No newline at end of file
+var util = require('util');
+var Readable = require('stream').Readable;
+
+// Built on N-API, one binary serves all Node.js versions
+var binding = require('bindings')({ bindings: 'sapnwrfc', version: 'napi-v6' });
+
+/**
+ * Readable stream of row batches, each batch is converted in its own turn of
+ * the event loop.
+ */
+function TableStream(cursor) {
+  Readable.call(this, { objectMode: true, highWaterMark: 1 });
+  this.cursor = cursor;
+  this.closed = false;
+  this.rowCount = cursor.RowCount();
+}
+util.inherits(TableStream, Readable);
+
+TableStream.prototype._read = function () {
+  var self = this;
+
+  setImmediate(function () {
+    if (self.closed) {
+      return;
+    }
+    var batch = self.cursor.Next();
+    if (batch instanceof Error) {
+      self.emit('error', batch);
+      return;
+    }
+    self.push(batch);
+  });
+};
+
+TableStream.prototype.close = function () {
+  if (!this.closed) {
+    this.closed = true;
+    this.cursor.Close();
+    this.push(null);
+  }
+};
+
+function isStreaming(options) {
+  return typeof options === 'object' && options !== null && options.tables === 'stream';
+}
+
+function wrapCursors(result) {
+  if (result) {
+    Object.keys(result).forEach(function (name) {
+      if (result[name] instanceof binding.TableCursor) {
+        result[name] = new TableStream(result[name]);
+      }
+    });
+  }
+  return result;
+}
+
+var invoke = binding.Function.prototype.Invoke;
+
+binding.Function.prototype.Invoke = function (params, options, callback) {
+  if (!isStreaming(options) || typeof callback !== 'function') {
+    return invoke.apply(this, arguments);
+  }
+
+  return invoke.call(this, params, options, function (err, result) {
+    callback(err, wrapCursors(result));
+  });
+};
+
+var invokeAsync = binding.Function.prototype.InvokeAsync;
+
+binding.Function.prototype.InvokeAsync = function (params, options) {
+  var promise = invokeAsync.apply(this, arguments);
+  return isStreaming(options) ? promise.then(wrapCursors) : promise;
+};
+
+binding.TableStream = TableStream;
+
+module.exports = binding;
@@ -0,0 +1,85 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Common.h"
+#include "AddonState.h"
+#include <cassert>
+
+static thread_local AddonState *current = nullptr;
+
+AddonState::AddonState(napi_env env) :
+  env(env),
+  functionCtor(nullptr),
+  tableCursorCtor(nullptr),
+  sink(nullptr),
+  connectionCount(0)
+{
+}
+
+AddonState::~AddonState()
+{
+  if (this->functionCtor != nullptr) {
+    napi_delete_reference(this->env, this->functionCtor);
+  }
+  if (this->tableCursorCtor != nullptr) {
+    napi_delete_reference(this->env, this->tableCursorCtor);
+  }
+}
+
+AddonState* AddonState::Create(napi_env env)
+{
+  // Loading the module twice into the same isolate reuses its state
+  if (current != nullptr) {
+    return current;
+  }
+
+  current = new AddonState(env);
+  current->sink = WorkerPool::NewSink(env);
+
+  napi_add_env_cleanup_hook(env, Cleanup, current);
+
+  return current;
+}
+
+AddonState* AddonState::Current(void)
+{
+  assert(current != nullptr);
+  return current;
+}
+
+/**
+ * Runs when the environment of the isolate is torn down, e.g. a worker thread exits
+ */
+void AddonState::Cleanup(void *arg)
+{
+  AddonState *state = static_cast<AddonState*>(arg);
+
+  WorkerPool::CloseSink(state->sink);
+  state->sink = nullptr;
+
+  if (current == state) {
+    current = nullptr;
+  }
+  delete state;
+}
@@ -0,0 +1,59 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef ADDONSTATE_H_
+#define ADDONSTATE_H_
+
+#include "Common.h"
+#include "WorkerPool.h"
+
+/**
+ * State of the addon in one isolate. The main thread and every worker thread
+ * that loads the module have their own, so nothing here may be shared with
+ * another isolate. Only used on the thread of its isolate.
+ */
+class AddonState
+{
+  public:
+  // Called by the module initialization of every isolate
+  static AddonState* Create(napi_env env);
+  static AddonState* Current(void);
+
+  napi_env env;
+  napi_ref functionCtor;
+  napi_ref tableCursorCtor;
+
+  // Receives the completed tasks of the worker pool on the loop of this isolate
+  WorkerPool::Sink *sink;
+
+  unsigned int connectionCount;
+
+  protected:
+  explicit AddonState(napi_env env);
+  ~AddonState();
+
+  static void Cleanup(void *arg);
+};
+
+#endif /* ADDONSTATE_H_ */
@@ -0,0 +1,68 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Common.h"
+#include "Arena.h"
+#include <cassert>
+#include <stdlib.h>
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 8
+
+Arena::~Arena()
+{
+  for (unsigned int i = 0; i < this->blocks.size(); i++) {
+    free(this->blocks[i]);
+  }
+}
+
+void* Arena::Allocate(size_t size)
+{
+  size = (size + ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(ARENA_ALIGNMENT - 1);
+
+  // Large values get a block of their own, so the current block is not wasted
+  if (size > ARENA_BLOCK_SIZE / 4) {
+    return this->AddBlock(size);
+  }
+
+  if (this->current == nullptr || this->used + size > this->capacity) {
+    this->current = this->AddBlock(ARENA_BLOCK_SIZE);
+    this->used = 0;
+    this->capacity = ARENA_BLOCK_SIZE;
+  }
+
+  void *memory = this->current + this->used;
+  this->used += size;
+
+  return memory;
+}
+
+char* Arena::AddBlock(size_t size)
+{
+  char *block = static_cast<char*>(malloc(size > 0 ? size : 1));
+  assert(block);
+  this->blocks.push_back(block);
+
+  return block;
+}
@@ -0,0 +1,58 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include "Common.h"
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Bump allocator for the values of one invocation or batch. Memory is only
+ * released as a whole when the arena is destroyed. Not thread safe, but may
+ * be handed from one thread to another.
+ */
+class Arena
+{
+  public:
+  Arena() : current(nullptr), used(0), capacity(0) { };
+  ~Arena();
+
+  void* Allocate(size_t size);
+
+  protected:
+  char* AddBlock(size_t size);
+
+  std::vector<char*> blocks;
+  char *current;
+  size_t used;
+  size_t capacity;
+
+  private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+};
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,238 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Common.h"
+#include "Cancellation.h"
+#include "Connection.h"
+#include "ConnectionPool.h"
+#include <sstream>
+
+Cancellation::Cancellation(napi_env env) :
+  env(env),
+  timeout(0),
+  timer(nullptr),
+  req(nullptr),
+  connection(nullptr),
+  pool(nullptr),
+  signal(nullptr),
+  listener(nullptr),
+  connectionHandle(nullptr),
+  reason(REASON_NONE),
+  finished(false)
+{
+  uv_mutex_init(&this->mutex);
+}
+
+Cancellation::~Cancellation()
+{
+  if (this->signal != nullptr) {
+    napi_delete_reference(this->env, this->signal);
+  }
+  if (this->listener != nullptr) {
+    napi_delete_reference(this->env, this->listener);
+  }
+  delete this->timer;
+  uv_mutex_destroy(&this->mutex);
+}
+
+bool Cancellation::Arm(unsigned int timeout, napi_value signal)
+{
+  HandleScope scope(this->env);
+
+  if (signal != nullptr) {
+    if (BooleanValue(this->env, Get(this->env, signal, "aborted"))) {
+      this->Cancel(REASON_ABORT);
+      return false;
+    }
+
+    napi_value listener, result;
+    napi_create_function(this->env, "onabort", NAPI_AUTO_LENGTH, OnAbort, this, &listener);
+    napi_value argv[2];
+    argv[0] = NewString(this->env, "abort");
+    argv[1] = listener;
+    napi_call_function(this->env, signal, Get(this->env, signal, "addEventListener"), 2, argv, &result);
+
+    napi_create_reference(this->env, signal, 1, &this->signal);
+    napi_create_reference(this->env, listener, 1, &this->listener);
+  }
+
+  if (timeout > 0) {
+    uv_loop_t *loop = nullptr;
+    napi_get_uv_event_loop(this->env, &loop);
+
+    this->timeout = timeout;
+    this->timer = new uv_timer_t();
+    uv_timer_init(loop, this->timer);
+    this->timer->data = this;
+    uv_timer_start(this->timer, OnTimeout, timeout, 0);
+    // The invocation itself keeps the loop alive
+    uv_unref(reinterpret_cast<uv_handle_t*>(this->timer));
+  }
+
+  return true;
+}
+
+void Cancellation::Track(uv_work_t *req, Connection *connection, ConnectionPool *pool)
+{
+  this->req = req;
+  this->connection = connection;
+  this->pool = pool;
+}
+
+void Cancellation::Cancel(Reason reason)
+{
+  RFC_ERROR_INFO errorInfo;
+  bool waiting = false;
+
+  uv_mutex_lock(&this->mutex);
+  if (this->reason == REASON_NONE && !this->finished) {
+    this->reason = reason;
+    if (this->connectionHandle != nullptr) {
+      RfcCancel(this->connectionHandle, &errorInfo);
+    } else {
+      waiting = true;
+    }
+  }
+  uv_mutex_unlock(&this->mutex);
+
+  if (!waiting || this->req == nullptr) {
+    return;
+  }
+
+  // Don't wait for the calls ahead in the queue, which may hang themselves.
+  // Otherwise the worker thread sees the cancellation before it invokes.
+  if (this->connection != nullptr) {
+    this->connection->Cancel(this->req);
+  } else if (this->pool != nullptr) {
+    this->pool->Cancel(this->req);
+  }
+}
+
+void Cancellation::Dispose()
+{
+  HandleScope scope(this->env);
+
+  if (this->listener != nullptr) {
+    napi_value signal = Reference(this->env, this->signal);
+    napi_value remove = Get(this->env, signal, "removeEventListener");
+    if (IsFunction(this->env, remove)) {
+      napi_value argv[2], result;
+      argv[0] = NewString(this->env, "abort");
+      argv[1] = Reference(this->env, this->listener);
+      if (napi_call_function(this->env, signal, remove, 2, argv, &result) == napi_pending_exception) {
+        napi_get_and_clear_last_exception(this->env, &result);
+      }
+    }
+  }
+
+  if (this->timer != nullptr) {
+    uv_timer_stop(this->timer);
+    uv_close(reinterpret_cast<uv_handle_t*>(this->timer), OnClose);
+  } else {
+    delete this;
+  }
+}
+
+bool Cancellation::Begin(RFC_CONNECTION_HANDLE connectionHandle)
+{
+  uv_mutex_lock(&this->mutex);
+  bool cancelled = this->reason != REASON_NONE;
+  if (cancelled) {
+    this->finished = true;
+  } else {
+    this->connectionHandle = connectionHandle;
+  }
+  uv_mutex_unlock(&this->mutex);
+
+  return !cancelled;
+}
+
+bool Cancellation::Cancelled()
+{
+  uv_mutex_lock(&this->mutex);
+  bool cancelled = this->reason != REASON_NONE;
+  uv_mutex_unlock(&this->mutex);
+
+  return cancelled;
+}
+
+bool Cancellation::End()
+{
+  uv_mutex_lock(&this->mutex);
+  this->connectionHandle = nullptr;
+  this->finished = true;
+  bool cancelled = this->reason != REASON_NONE;
+  uv_mutex_unlock(&this->mutex);
+
+  return cancelled;
+}
+
+void Cancellation::GetError(RFC_ERROR_INFO *errorInfo)
+{
+  std::ostringstream message;
+  const SAP_UC *key;
+
+  uv_mutex_lock(&this->mutex);
+  if (this->reason == REASON_TIMEOUT) {
+    key = cU("RFC_TIMEOUT");
+    message << "Invocation timed out after " << this->timeout << " ms";
+  } else {
+    key = cU("RFC_ABORTED");
+    message << "Invocation was aborted";
+  }
+  uv_mutex_unlock(&this->mutex);
+
+  memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  errorInfo->code = RFC_CANCELED;
+  errorInfo->group = EXTERNAL_RUNTIME_FAILURE;
+  strncpyU(errorInfo->key, key, sizeof(errorInfo->key) / sizeof(SAP_UC) - 1);
+  // Plain ASCII, so widening each character is enough
+  std::string text = message.str();
+  for (unsigned int i = 0; i < text.size() && i < sizeof(errorInfo->message) / sizeof(SAP_UC) - 1; i++) {
+    errorInfo->message[i] = (SAP_UC)text[i];
+  }
+}
+
+void Cancellation::OnTimeout(uv_timer_t *handle)
+{
+  Cancellation *self = static_cast<Cancellation*>(handle->data);
+
+  self->Cancel(REASON_TIMEOUT);
+}
+
+void Cancellation::OnClose(uv_handle_t *handle)
+{
+  Cancellation *self = static_cast<Cancellation*>(handle->data);
+
+  delete self;
+}
+
+NAPI_METHOD(Cancellation::OnAbort)
+{
+  CallbackInfo info(env, cbinfo);
+  Cancellation *self = static_cast<Cancellation*>(info.Data());
+
+  self->Cancel(REASON_ABORT);
+  return nullptr;
+}
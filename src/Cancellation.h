@@ -0,0 +1,99 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef CANCELLATION_H_
+#define CANCELLATION_H_
+
+#include "Common.h"
+#include <uv.h>
+#include <sapnwrfc.h>
+
+class Connection;
+class ConnectionPool;
+
+/**
+ * Stops an invocation after a timeout or when an AbortSignal fires. A call
+ * that is still queued is taken out of its queue and fails right away. The
+ * worker thread registers its connection handle while it is inside
+ * RfcInvoke, so that the main thread can call RfcCancel on it.
+ */
+class Cancellation
+{
+  public:
+  enum Reason {
+    REASON_NONE,
+    REASON_TIMEOUT,
+    REASON_ABORT
+  };
+
+  explicit Cancellation(napi_env env);
+
+  // Main thread, the signal may be null and a timeout of 0 means none.
+  // Returns false if the signal has already been aborted.
+  bool Arm(unsigned int timeout, napi_value signal);
+  // Main thread, before the request is queued on the connection or the connection pool
+  void Track(uv_work_t *req, Connection *connection, ConnectionPool *pool);
+  void Cancel(Reason reason);
+  // Main thread, stops the timer and the listener and frees the cancellation
+  void Dispose();
+
+  // Worker thread, returns false if cancelled before the call could start
+  bool Begin(RFC_CONNECTION_HANDLE connectionHandle);
+  // Worker thread, returns true if the call was cancelled while it was running
+  bool End();
+  // Any thread, whether a timeout or abort has happened
+  bool Cancelled();
+
+  // The error to report instead of the one of the cancelled call
+  void GetError(RFC_ERROR_INFO *errorInfo);
+
+  protected:
+  ~Cancellation();
+
+  static void OnTimeout(uv_timer_t *handle);
+  static void OnClose(uv_handle_t *handle);
+  static NAPI_METHOD(OnAbort);
+
+  napi_env env;
+  unsigned int timeout;
+  uv_timer_t *timer;
+  // Where the request waits until a worker thread picks it up
+  uv_work_t *req;
+  Connection *connection;
+  ConnectionPool *pool;
+  napi_ref signal;
+  napi_ref listener;
+
+  // Guarded by mutex, also held during RfcCancel so the handle stays in use
+  uv_mutex_t mutex;
+  RFC_CONNECTION_HANDLE connectionHandle;
+  Reason reason;
+  bool finished;
+
+  private:
+  Cancellation(const Cancellation&);
+  Cancellation& operator=(const Cancellation&);
+};
+
+#endif /* CANCELLATION_H_ */
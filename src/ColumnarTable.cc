@@ -0,0 +1,389 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "ColumnarTable.h"
+#include <algorithm>
+#include <cassert>
+#include <limits.h>
+#include <stdlib.h>
+
+#define DECIMAL_BUFFER_SIZE 64
+
+static void SetColumnError(RFC_ERROR_INFO *errorInfo, const SAP_UC *message, const SAP_UC *fieldName)
+{
+  const unsigned int maxLength = sizeof(errorInfo->message) / sizeof(SAP_UC) - 1;
+
+  memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  errorInfo->code = RFC_CONVERSION_FAILURE;
+  errorInfo->group = EXTERNAL_RUNTIME_FAILURE;
+  strncpyU(errorInfo->key, cU("RFC_CONVERSION_FAILURE"), sizeof(errorInfo->key) / sizeof(SAP_UC) - 1);
+  strncpyU(errorInfo->message, message, maxLength);
+
+  unsigned int length = strlenU(errorInfo->message);
+  if (length < maxLength) {
+    strncpyU(errorInfo->message + length, fieldName, maxLength - length);
+  }
+}
+
+static size_t FixedWidth(Column::Kind kind)
+{
+  switch (kind) {
+    case Column::COLUMN_FLOAT64:
+      return sizeof(double);
+    case Column::COLUMN_INT64:
+      return sizeof(int64_t);
+    case Column::COLUMN_INT32:
+      return sizeof(int32_t);
+    case Column::COLUMN_INT16:
+      return sizeof(int16_t);
+    case Column::COLUMN_UINT8:
+      return sizeof(uint8_t);
+    default:
+      return 0;
+  }
+}
+
+ColumnarTable::~ColumnarTable()
+{
+  for (unsigned int i = 0; i < this->columns.size(); i++) {
+    free(this->columns[i].data);
+    free(this->columns[i].offsets);
+  }
+}
+
+bool ColumnarTable::Fill(RFC_TABLE_HANDLE tableHandle, const TypePlan &typePlan, bool rtrim, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+
+  this->rtrim = rtrim;
+
+  rc = RfcGetRowCount(tableHandle, &this->rowCount, errorInfo);
+  if (rc != RFC_OK) {
+    return false;
+  }
+
+  this->typePlan = &typePlan;
+  this->columns.resize(typePlan.fields.size());
+
+  for (unsigned int i = 0; i < typePlan.fields.size(); i++) {
+    Column &column = this->columns[i];
+    column.field = &typePlan.fields[i];
+
+    switch (column.field->type) {
+      case RFCTYPE_FLOAT:
+      case RFCTYPE_BCD:
+      case RFCTYPE_DECF16:
+      case RFCTYPE_DECF34:
+        column.kind = Column::COLUMN_FLOAT64;
+        break;
+      case RFCTYPE_INT8:
+        column.kind = Column::COLUMN_INT64;
+        break;
+      case RFCTYPE_INT:
+        column.kind = Column::COLUMN_INT32;
+        break;
+      case RFCTYPE_INT2:
+        column.kind = Column::COLUMN_INT16;
+        break;
+      case RFCTYPE_INT1:
+        column.kind = Column::COLUMN_UINT8;
+        break;
+      case RFCTYPE_CHAR:
+      case RFCTYPE_NUM:
+      case RFCTYPE_DATE:
+      case RFCTYPE_TIME:
+      case RFCTYPE_STRING:
+      case RFCTYPE_UTCLONG:
+        column.kind = Column::COLUMN_STRING;
+        break;
+      case RFCTYPE_BYTE:
+      case RFCTYPE_XSTRING:
+        column.kind = Column::COLUMN_BINARY;
+        break;
+      default:
+        SetColumnError(errorInfo, cU("Field type not supported in columnar mode: "), column.field->name);
+        return false;
+    }
+
+    if (column.kind == Column::COLUMN_STRING || column.kind == Column::COLUMN_BINARY) {
+      column.offsets = static_cast<int32_t*>(malloc((this->rowCount + 1) * sizeof(int32_t)));
+      assert(column.offsets);
+      column.offsets[0] = 0;
+      // Good guess for single byte characters, grows on demand. Only the values themselves can exceed the limit.
+      size_t guess = (size_t)this->rowCount * column.field->nucLength;
+      this->Reserve(column, std::min(guess, (size_t)INT_MAX));
+    } else {
+      column.capacity = this->rowCount * FixedWidth(column.kind);
+      column.length = column.capacity;
+      column.data = static_cast<char*>(malloc(column.capacity > 0 ? column.capacity : 1));
+      assert(column.data);
+    }
+  }
+
+  for (unsigned int r = 0; r < this->rowCount; r++) {
+    rc = RfcMoveTo(tableHandle, r, errorInfo);
+    if (rc != RFC_OK) {
+      return false;
+    }
+    RFC_STRUCTURE_HANDLE row = RfcGetCurrentRow(tableHandle, errorInfo);
+    if (row == nullptr) {
+      return false;
+    }
+
+    for (unsigned int i = 0; i < this->columns.size(); i++) {
+      if (!this->FillValue(this->columns[i], row, r, errorInfo)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool ColumnarTable::FillValue(Column &column, RFC_STRUCTURE_HANDLE row, unsigned int rowIndex, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  const FieldPlan &field = *column.field;
+  unsigned int length = 0;
+
+  switch (field.type) {
+    case RFCTYPE_FLOAT:
+      rc = RfcGetFloat(row, field.name, reinterpret_cast<double*>(column.data) + rowIndex, errorInfo);
+      break;
+    case RFCTYPE_BCD:
+    case RFCTYPE_DECF16:
+    case RFCTYPE_DECF34: {
+      SAP_UC decimal[DECIMAL_BUFFER_SIZE];
+      char ascii[DECIMAL_BUFFER_SIZE];
+
+      rc = RfcGetString(row, field.name, decimal, DECIMAL_BUFFER_SIZE, &length, errorInfo);
+      if (rc == RFC_OK) {
+        // Decimal strings only consist of ASCII characters
+        for (unsigned int i = 0; i < length; i++) {
+          ascii[i] = static_cast<char>(decimal[i]);
+        }
+        ascii[length] = '\0';
+        reinterpret_cast<double*>(column.data)[rowIndex] = strtod(ascii, nullptr);
+      }
+      break;
+    }
+    case RFCTYPE_INT:
+      rc = RfcGetInt(row, field.name, reinterpret_cast<RFC_INT*>(column.data) + rowIndex, errorInfo);
+      break;
+    case RFCTYPE_INT2:
+      rc = RfcGetInt2(row, field.name, reinterpret_cast<RFC_INT2*>(column.data) + rowIndex, errorInfo);
+      break;
+    case RFCTYPE_INT1:
+      rc = RfcGetInt1(row, field.name, reinterpret_cast<RFC_INT1*>(column.data) + rowIndex, errorInfo);
+      break;
+    case RFCTYPE_CHAR:
+    case RFCTYPE_NUM:
+    case RFCTYPE_DATE:
+    case RFCTYPE_TIME:
+      this->buffer.resize((field.nucLength + 1) * sizeof(SAP_UC));
+      length = field.nucLength;
+      if (field.type == RFCTYPE_CHAR) {
+        rc = RfcGetChars(row, field.name, reinterpret_cast<RFC_CHAR*>(&this->buffer[0]), length, errorInfo);
+      } else if (field.type == RFCTYPE_NUM) {
+        rc = RfcGetNum(row, field.name, reinterpret_cast<RFC_NUM*>(&this->buffer[0]), length, errorInfo);
+      } else if (field.type == RFCTYPE_DATE) {
+        rc = RfcGetDate(row, field.name, reinterpret_cast<RFC_CHAR*>(&this->buffer[0]), errorInfo);
+      } else {
+        rc = RfcGetTime(row, field.name, reinterpret_cast<RFC_CHAR*>(&this->buffer[0]), errorInfo);
+      }
+      if (this->rtrim && (field.type == RFCTYPE_CHAR || field.type == RFCTYPE_NUM)) {
+        length = Unicode::TrimmedLength(reinterpret_cast<SAP_UC*>(&this->buffer[0]), length);
+      }
+      if (rc == RFC_OK && !this->AppendUTF8(column, reinterpret_cast<SAP_UC*>(&this->buffer[0]), length, errorInfo)) {
+        return false;
+      }
+      break;
+    case RFCTYPE_INT8:
+      rc = RfcGetInt8(row, field.name, reinterpret_cast<RFC_INT8*>(column.data) + rowIndex, errorInfo);
+      break;
+    case RFCTYPE_UTCLONG:
+      this->buffer.resize(DECIMAL_BUFFER_SIZE * sizeof(SAP_UC));
+      rc = RfcGetString(row, field.name, reinterpret_cast<SAP_UC*>(&this->buffer[0]), DECIMAL_BUFFER_SIZE, &length, errorInfo);
+      if (rc == RFC_OK && !this->AppendUTF8(column, reinterpret_cast<SAP_UC*>(&this->buffer[0]), length, errorInfo)) {
+        return false;
+      }
+      break;
+    case RFCTYPE_STRING:
+      rc = RfcGetStringLength(row, field.name, &length, errorInfo);
+      if (rc == RFC_OK && length > 0) {
+        this->buffer.resize((length + 1) * sizeof(SAP_UC));
+        rc = RfcGetString(row, field.name, reinterpret_cast<SAP_UC*>(&this->buffer[0]), length + 1, &length, errorInfo);
+      }
+      if (rc == RFC_OK && !this->AppendUTF8(column, reinterpret_cast<SAP_UC*>(&this->buffer[0]), length, errorInfo)) {
+        return false;
+      }
+      break;
+    case RFCTYPE_BYTE:
+      this->buffer.resize(field.nucLength + 1);
+      length = field.nucLength;
+      rc = RfcGetBytes(row, field.name, reinterpret_cast<SAP_RAW*>(&this->buffer[0]), length, errorInfo);
+      if (rc == RFC_OK && !this->AppendBytes(column, reinterpret_cast<SAP_RAW*>(&this->buffer[0]), length)) {
+        SetColumnError(errorInfo, cU("Column exceeds maximum size: "), field.name);
+        return false;
+      }
+      break;
+    case RFCTYPE_XSTRING:
+      rc = RfcGetStringLength(row, field.name, &length, errorInfo);
+      if (rc == RFC_OK && length > 0) {
+        this->buffer.resize(length);
+        rc = RfcGetXString(row, field.name, reinterpret_cast<SAP_RAW*>(&this->buffer[0]), length, &length, errorInfo);
+      }
+      if (rc == RFC_OK && !this->AppendBytes(column, reinterpret_cast<SAP_RAW*>(&this->buffer[0]), length)) {
+        SetColumnError(errorInfo, cU("Column exceeds maximum size: "), field.name);
+        return false;
+      }
+      break;
+    default:
+      assert(0);
+      break;
+  }
+
+  if (rc != RFC_OK) {
+    return false;
+  }
+
+  if (column.offsets != nullptr) {
+    column.offsets[rowIndex + 1] = static_cast<int32_t>(column.length);
+  }
+
+  return true;
+}
+
+/**
+ * Makes room for additional bytes, offsets are limited to 32 bits
+ */
+bool ColumnarTable::Reserve(Column &column, size_t additional)
+{
+  size_t required = column.length + additional;
+  if (required > INT_MAX) {
+    return false;
+  }
+  if (column.data != nullptr && required <= column.capacity) {
+    return true;
+  }
+
+  size_t capacity = column.capacity > 0 ? column.capacity : 64;
+  while (capacity < required) {
+    capacity *= 2;
+  }
+  if (capacity > INT_MAX) {
+    capacity = INT_MAX;
+  }
+
+  char *data = static_cast<char*>(realloc(column.data, capacity));
+  assert(data);
+  column.data = data;
+  column.capacity = capacity;
+
+  return true;
+}
+
+bool ColumnarTable::AppendUTF8(Column &column, const SAP_UC *value, unsigned int length, RFC_ERROR_INFO *errorInfo)
+{
+  if (length == 0) {
+    return true;
+  }
+
+  // A UTF-16 code unit needs at most 3 bytes in UTF-8
+  size_t worstCase = (size_t)length * 3;
+  if (column.length + worstCase > INT_MAX) {
+    // Close to the limit, only the bytes actually written have to fit
+    std::vector<char> utf8(worstCase);
+    size_t utf8Length = Unicode::ToUTF8(value, length, &utf8[0]);
+    if (utf8Length > INT_MAX || !this->AppendBytes(column, reinterpret_cast<SAP_RAW*>(&utf8[0]), utf8Length)) {
+      SetColumnError(errorInfo, cU("Column exceeds maximum size: "), column.field->name);
+      return false;
+    }
+    return true;
+  }
+
+  this->Reserve(column, worstCase);
+  column.length += Unicode::ToUTF8(value, length, column.data + column.length);
+
+  return true;
+}
+
+bool ColumnarTable::AppendBytes(Column &column, const SAP_RAW *value, unsigned int length)
+{
+  if (!this->Reserve(column, length)) {
+    return false;
+  }
+
+  memcpy(column.data + column.length, value, length);
+  column.length += length;
+
+  return true;
+}
+
+napi_value ColumnarTable::ToJS(napi_env env)
+{
+  napi_value result = NewObject(env);
+
+  for (unsigned int i = 0; i < this->columns.size(); i++) {
+    Column &column = this->columns[i];
+    napi_value value;
+
+    if (column.offsets != nullptr) {
+      value = NewObject(env);
+      napi_value offsets;
+      napi_create_typedarray(env, napi_int32_array, this->rowCount + 1,
+        TakeArrayBuffer(env, reinterpret_cast<char*>(column.offsets), (this->rowCount + 1) * sizeof(int32_t)), 0, &offsets);
+      Set(env, value, "data", TakeBuffer(env, column.data, column.length));
+      Set(env, value, "offsets", offsets);
+    } else {
+      napi_typedarray_type type;
+      switch (column.kind) {
+        case Column::COLUMN_FLOAT64:
+          type = napi_float64_array;
+          break;
+        case Column::COLUMN_INT64:
+          type = napi_bigint64_array;
+          break;
+        case Column::COLUMN_INT32:
+          type = napi_int32_array;
+          break;
+        case Column::COLUMN_INT16:
+          type = napi_int16_array;
+          break;
+        default:
+          type = napi_uint8_array;
+          break;
+      }
+      napi_create_typedarray(env, type, this->rowCount, TakeArrayBuffer(env, column.data, column.length), 0, &value);
+    }
+
+    // Ownership has passed to the buffers
+    column.data = nullptr;
+    column.offsets = nullptr;
+
+    Set(env, result, this->typePlan->names.Get(env, i), value);
+  }
+
+  return result;
+}
@@ -0,0 +1,89 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef COLUMNARTABLE_H_
+#define COLUMNARTABLE_H_
+
+#include "Common.h"
+#include <sapnwrfc.h>
+#include <vector>
+#include "FunctionPlan.h"
+
+/**
+ * One field of a table, stored as contiguous values. Strings and binary
+ * fields are stored as concatenated bytes plus rowCount + 1 offsets.
+ */
+class Column
+{
+  public:
+  enum Kind {
+    COLUMN_FLOAT64,
+    COLUMN_INT64,
+    COLUMN_INT32,
+    COLUMN_INT16,
+    COLUMN_UINT8,
+    COLUMN_STRING,
+    COLUMN_BINARY
+  };
+
+  Column() : kind(COLUMN_FLOAT64), field(nullptr), data(nullptr), length(0), capacity(0), offsets(nullptr) { };
+
+  Kind kind;
+  const FieldPlan *field;
+  // malloc'ed, ownership passes to the JS buffers in ToJS
+  char *data;
+  size_t length;
+  size_t capacity;
+  int32_t *offsets;
+};
+
+/**
+ * Struct-of-arrays copy of a table. Fill runs on the worker thread,
+ * ToJS on the main thread.
+ */
+class ColumnarTable
+{
+  public:
+  ColumnarTable() : rowCount(0), rtrim(false), typePlan(nullptr) { };
+  ~ColumnarTable();
+
+  bool Fill(RFC_TABLE_HANDLE tableHandle, const TypePlan &typePlan, bool rtrim, RFC_ERROR_INFO *errorInfo);
+  napi_value ToJS(napi_env env);
+
+  protected:
+  bool FillValue(Column &column, RFC_STRUCTURE_HANDLE row, unsigned int rowIndex, RFC_ERROR_INFO *errorInfo);
+  bool Reserve(Column &column, size_t additional);
+  bool AppendUTF8(Column &column, const SAP_UC *value, unsigned int length, RFC_ERROR_INFO *errorInfo);
+  bool AppendBytes(Column &column, const SAP_RAW *value, unsigned int length);
+
+  unsigned int rowCount;
+  // Strip the blanks padding CHAR and NUM values
+  bool rtrim;
+  const TypePlan *typePlan;
+  std::vector<Column> columns;
+  // Scratch space for reading single values
+  std::vector<char> buffer;
+};
+
+#endif /* COLUMNARTABLE_H_ */
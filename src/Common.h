@@ -22,137 +22,500 @@ SOFTWARE.
 -----------------------------------------------------------------------------
 */
 
+
 #ifndef COMMON_H_
 #define COMMON_H_
 
-#include <v8.h>
-#include <nan.h>
+#include <node_api.h>
 #include <sapnwrfc.h>
 #include <iostream>
+#include <string>
+#include "Unicode.h"
 
 #ifndef nullptr
 #define nullptr NULL
 #endif
 
-#define ESCAPE_RFC_ERROR(...) scope.Escape(RfcError(__VA_ARGS__));
-#define RETURN_RFC_ERROR(...) info.GetReturnValue().Set(RfcError(__VA_ARGS__)); return;
+#define NAPI_METHOD(name) napi_value name(napi_env env, napi_callback_info cbinfo)
+#define RETURN_RFC_ERROR(...) return RfcError(env, __VA_ARGS__);
 
 typedef DATA_CONTAINER_HANDLE CHND;
 
-static std::string convertToString(v8::Local<v8::Value> const &str)
+/**
+ * Arguments and receiver of a call from JavaScript
+ */
+class CallbackInfo
 {
-  Nan::HandleScope scope;
-  static const std::string emptyString;
+  public:
+  CallbackInfo(napi_env env, napi_callback_info cbinfo) :
+    argc(MAX_ARGS), thisArg(nullptr), newTarget(nullptr), data(nullptr)
+  {
+    napi_get_cb_info(env, cbinfo, &this->argc, this->argv, &this->thisArg, &this->data);
+    napi_get_new_target(env, cbinfo, &this->newTarget);
+    napi_get_undefined(env, &this->undefined);
+  };
 
-  v8::String::Utf8Value utf8String(str);
-  const char *s = *utf8String;
-  if (s != nullptr) {
-    return std::string(s, utf8String.length());
+  size_t Length() const { return this->argc; };
+  // Undefined beyond the arguments passed, like in JavaScript
+  napi_value operator[](size_t i) const { return i < this->argc && i < MAX_ARGS ? this->argv[i] : this->undefined; };
+  napi_value This() const { return this->thisArg; };
+  void* Data() const { return this->data; };
+  bool IsConstructCall() const { return this->newTarget != nullptr; };
+
+  private:
+  enum { MAX_ARGS = 4 };
+
+  size_t argc;
+  napi_value argv[MAX_ARGS];
+  napi_value thisArg;
+  napi_value newTarget;
+  napi_value undefined;
+  void *data;
+};
+
+/**
+ * Needed wherever handles are created outside of a call from JavaScript
+ */
+class HandleScope
+{
+  public:
+  explicit HandleScope(napi_env env) : env(env) { napi_open_handle_scope(env, &this->scope); };
+  ~HandleScope() { napi_close_handle_scope(this->env, this->scope); };
+
+  private:
+  HandleScope(const HandleScope&);
+  HandleScope& operator=(const HandleScope&);
+
+  napi_env env;
+  napi_handle_scope scope;
+};
+
+class EscapableHandleScope
+{
+  public:
+  explicit EscapableHandleScope(napi_env env) : env(env) { napi_open_escapable_handle_scope(env, &this->scope); };
+  ~EscapableHandleScope() { napi_close_escapable_handle_scope(this->env, this->scope); };
+
+  napi_value Escape(napi_value value) {
+    napi_value escaped = nullptr;
+    napi_escape_handle(this->env, this->scope, value, &escaped);
+    return escaped;
+  };
+
+  private:
+  EscapableHandleScope(const EscapableHandleScope&);
+  EscapableHandleScope& operator=(const EscapableHandleScope&);
+
+  napi_env env;
+  napi_escapable_handle_scope scope;
+};
+
+static inline napi_value Undefined(napi_env env)
+{
+  napi_value value;
+  napi_get_undefined(env, &value);
+  return value;
+}
+
+static inline napi_value Null(napi_env env)
+{
+  napi_value value;
+  napi_get_null(env, &value);
+  return value;
+}
+
+static inline napi_value Boolean(napi_env env, bool b)
+{
+  napi_value value;
+  napi_get_boolean(env, b, &value);
+  return value;
+}
+
+static inline napi_value Number(napi_env env, double d)
+{
+  napi_value value;
+  napi_create_double(env, d, &value);
+  return value;
+}
+
+static inline napi_value Int32(napi_env env, int32_t i)
+{
+  napi_value value;
+  napi_create_int32(env, i, &value);
+  return value;
+}
+
+static inline napi_value Uint32(napi_env env, uint32_t u)
+{
+  napi_value value;
+  napi_create_uint32(env, u, &value);
+  return value;
+}
+
+static inline napi_value NewObject(napi_env env)
+{
+  napi_value value;
+  napi_create_object(env, &value);
+  return value;
+}
+
+static inline napi_value NewArray(napi_env env, size_t length = 0)
+{
+  napi_value value;
+  napi_create_array_with_length(env, length, &value);
+  return value;
+}
+
+static inline napi_value NewString(napi_env env, const char *s)
+{
+  napi_value value;
+  napi_create_string_utf8(env, s, NAPI_AUTO_LENGTH, &value);
+  return value;
+}
+
+static inline napi_value NewString(napi_env env, const SAP_UC *s, size_t length = NAPI_AUTO_LENGTH)
+{
+  napi_value value;
+  napi_create_string_utf16(env, reinterpret_cast<const char16_t*>(s), length, &value);
+  return value;
+}
+
+static inline napi_valuetype TypeOf(napi_env env, napi_value value)
+{
+  napi_valuetype type = napi_undefined;
+  napi_typeof(env, value, &type);
+  return type;
+}
+
+static inline bool IsUndefined(napi_env env, napi_value value) { return TypeOf(env, value) == napi_undefined; }
+static inline bool IsNull(napi_env env, napi_value value) { return TypeOf(env, value) == napi_null; }
+static inline bool IsString(napi_env env, napi_value value) { return TypeOf(env, value) == napi_string; }
+static inline bool IsNumber(napi_env env, napi_value value) { return TypeOf(env, value) == napi_number; }
+static inline bool IsBigInt(napi_env env, napi_value value) { return TypeOf(env, value) == napi_bigint; }
+static inline bool IsFunction(napi_env env, napi_value value) { return TypeOf(env, value) == napi_function; }
+
+// Like v8::Value::IsObject, functions are objects as well
+static inline bool IsObject(napi_env env, napi_value value)
+{
+  napi_valuetype type = TypeOf(env, value);
+  return type == napi_object || type == napi_function;
+}
+
+static inline bool IsArray(napi_env env, napi_value value)
+{
+  bool result = false;
+  napi_is_array(env, value, &result);
+  return result;
+}
+
+static inline bool IsBuffer(napi_env env, napi_value value)
+{
+  bool result = false;
+  napi_is_buffer(env, value, &result);
+  return result;
+}
+
+static inline double NumberValue(napi_env env, napi_value value)
+{
+  double d = 0;
+  napi_get_value_double(env, value, &d);
+  return d;
+}
+
+static inline bool IsInt32(napi_env env, napi_value value)
+{
+  if (!IsNumber(env, value)) {
+    return false;
+  }
+  double d = NumberValue(env, value);
+  return d >= -2147483648.0 && d <= 2147483647.0 && d == static_cast<double>(static_cast<int32_t>(d));
+}
+
+static inline bool IsUint32(napi_env env, napi_value value)
+{
+  if (!IsNumber(env, value)) {
+    return false;
+  }
+  double d = NumberValue(env, value);
+  return d >= 0 && d <= 4294967295.0 && d == static_cast<double>(static_cast<uint32_t>(d));
+}
+
+static inline int32_t Int32Value(napi_env env, napi_value value)
+{
+  int32_t i = 0;
+  napi_get_value_int32(env, value, &i);
+  return i;
+}
+
+static inline uint32_t Uint32Value(napi_env env, napi_value value)
+{
+  uint32_t u = 0;
+  napi_get_value_uint32(env, value, &u);
+  return u;
+}
+
+// Truthiness, like v8::Value::BooleanValue
+static inline bool BooleanValue(napi_env env, napi_value value)
+{
+  napi_value coerced;
+  bool b = false;
+  if (napi_coerce_to_bool(env, value, &coerced) == napi_ok) {
+    napi_get_value_bool(env, coerced, &b);
+  }
+  return b;
+}
+
+static inline napi_value Get(napi_env env, napi_value object, const char *name)
+{
+  napi_value value = nullptr;
+  if (napi_get_named_property(env, object, name, &value) != napi_ok) {
+    return Undefined(env);
+  }
+  return value;
+}
+
+static inline napi_value Get(napi_env env, napi_value object, napi_value key)
+{
+  napi_value value = nullptr;
+  if (napi_get_property(env, object, key, &value) != napi_ok) {
+    return Undefined(env);
+  }
+  return value;
+}
+
+static inline napi_value Get(napi_env env, napi_value object, uint32_t index)
+{
+  napi_value value = nullptr;
+  if (napi_get_element(env, object, index, &value) != napi_ok) {
+    return Undefined(env);
   }
+  return value;
+}
+
+static inline void Set(napi_env env, napi_value object, const char *name, napi_value value)
+{
+  napi_set_named_property(env, object, name, value);
+}
+
+static inline void Set(napi_env env, napi_value object, napi_value key, napi_value value)
+{
+  napi_set_property(env, object, key, value);
+}
+
+static inline void Set(napi_env env, napi_value object, uint32_t index, napi_value value)
+{
+  napi_set_element(env, object, index, value);
+}
+
+static inline bool Has(napi_env env, napi_value object, napi_value key)
+{
+  bool result = false;
+  napi_has_property(env, object, key, &result);
+  return result;
+}
 
-  return emptyString;
+static inline uint32_t ArrayLength(napi_env env, napi_value array)
+{
+  uint32_t length = 0;
+  napi_get_array_length(env, array, &length);
+  return length;
+}
+
+// In UTF-16 code units, like v8::String::Length
+static inline size_t StringLength(napi_env env, napi_value str)
+{
+  size_t length = 0;
+  napi_get_value_string_utf16(env, str, nullptr, 0, &length);
+  return length;
+}
+
+static inline napi_value Reference(napi_env env, napi_ref ref)
+{
+  napi_value value = nullptr;
+  napi_get_reference_value(env, ref, &value);
+  return value;
+}
+
+// For napi_define_class and napi_define_properties, writable so that JavaScript may wrap the method
+static inline napi_property_descriptor Method(const char *name, napi_callback method)
+{
+  napi_property_descriptor descriptor = { name, nullptr, method, nullptr, nullptr, nullptr,
+    static_cast<napi_property_attributes>(napi_writable | napi_configurable), nullptr };
+  return descriptor;
+}
+
+// The return value of a method that has thrown
+static inline napi_value ThrowError(napi_env env, const char *message)
+{
+  napi_throw_error(env, nullptr, message);
+  return nullptr;
+}
+
+static inline napi_value Throw(napi_env env, napi_value error)
+{
+  napi_throw(env, error);
+  return nullptr;
+}
+
+static void FreeTakenMemory(napi_env env, void *data, void *hint)
+{
+  free(data);
+}
+
+/**
+ * The buffer takes over malloc'ed memory and frees it when collected. Where
+ * external memory is not allowed the data is copied and freed right away.
+ */
+static napi_value TakeBuffer(napi_env env, char *data, size_t length)
+{
+  napi_value buffer;
+
+  if (napi_create_external_buffer(env, length, data, FreeTakenMemory, nullptr, &buffer) != napi_ok) {
+    void *copy;
+    napi_create_buffer_copy(env, length, data, &copy, &buffer);
+    free(data);
+  }
+
+  return buffer;
+}
+
+static napi_value TakeArrayBuffer(napi_env env, char *data, size_t length)
+{
+  napi_value arrayBuffer;
+
+  if (napi_create_external_arraybuffer(env, data, length, FreeTakenMemory, nullptr, &arrayBuffer) != napi_ok) {
+    void *copy;
+    napi_create_arraybuffer(env, length, &copy, &arrayBuffer);
+    memcpy(copy, data, length);
+    free(data);
+  }
+
+  return arrayBuffer;
+}
+
+static std::string convertToString(napi_env env, napi_value str)
+{
+  napi_value s;
+  size_t length = 0;
+
+  if (napi_coerce_to_string(env, str, &s) != napi_ok ||
+      napi_get_value_string_utf8(env, s, nullptr, 0, &length) != napi_ok) {
+    return std::string();
+  }
+
+  std::string utf8String(length, '\0');
+  napi_get_value_string_utf8(env, s, &utf8String[0], length + 1, &length);
+
+  return utf8String;
 }
 
 static std::string convertToString(const SAP_UC *str)
 {
-  Nan::HandleScope scope;
-  v8::Local<v8::String> utf16String = Nan::New<v8::String>((const uint16_t*)(str)).ToLocalChecked();
+  size_t length = strlenU(str);
+  if (length == 0) {
+    return std::string();
+  }
 
-  return convertToString(utf16String);
+  std::string utf8String(length * 3, '\0');
+  utf8String.resize(Unicode::ToUTF8(str, length, &utf8String[0]));
+
+  return utf8String;
 }
 
-static SAP_UC* convertToSAPUC(v8::Local<v8::Value> const &str) {
-  RFC_RC rc;
-  RFC_ERROR_INFO errorInfo;
-  const char *cStr;
-  SAP_UC *sapuc;
-  unsigned sapucSize, resultLength;
+static SAP_UC* convertToSAPUC(napi_env env, napi_value str) {
+  napi_value s;
+  size_t length = 0;
 
-  std::string s = convertToString(str);
-  cStr = s.c_str();
+  // JavaScript strings are UTF-16 already, so they are copied without a conversion
+  if (napi_coerce_to_string(env, str, &s) != napi_ok ||
+      napi_get_value_string_utf16(env, s, nullptr, 0, &length) != napi_ok) {
+    s = nullptr;
+    length = 0;
+  }
 
-  sapucSize = strlen(cStr) + 1;
-  sapuc = mallocU(sapucSize);
-  memsetU(sapuc, 0, sapucSize);
-  resultLength = 0;
-  rc = RfcUTF8ToSAPUC((RFC_BYTE*)cStr, strlen(cStr), sapuc, &sapucSize, &resultLength, &errorInfo);
+  SAP_UC *sapuc = mallocU(length + 1);
+  if (s != nullptr) {
+    napi_get_value_string_utf16(env, s, reinterpret_cast<char16_t*>(sapuc), length + 1, &length);
+  }
+  sapuc[length] = 0;
 
   return sapuc;
 }
 
-static v8::Local<v8::Value> RfcError(const RFC_ERROR_INFO &info)
-{
-  Nan::EscapableHandleScope scope;
-
-  v8::Local<v8::Value> e = v8::Exception::Error(
-      Nan::New<v8::String>((const uint16_t*)(info.message)).ToLocalChecked()
-  );
-
-  v8::Local<v8::Object> obj = e->ToObject();
-  obj->Set(
-      Nan::New<v8::String>("code").ToLocalChecked(),
-      Nan::New<v8::Integer>(info.code)
-  );
-  obj->Set(
-      Nan::New<v8::String>("group").ToLocalChecked(),
-      Nan::New<v8::Integer>(info.group)
-  );
-  obj->Set(
-      Nan::New<v8::String>("key").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.key)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("class").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgClass)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("type").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgType)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("number").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgNumber)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("msgv1").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgV1)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("msgv2").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgV2)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("msgv3").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgV3)).ToLocalChecked()
-  );
-  obj->Set(
-      Nan::New<v8::String>("msgv4").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)(info.abapMsgV4)).ToLocalChecked()
-  );
-
-  return scope.Escape(obj);
-}
-
-static v8::Local<v8::Value> RfcError(const char* message, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-
-  v8::Local<v8::String> leftSide = Nan::New<v8::String>(message).ToLocalChecked();
-  v8::Local<v8::String> exceptionString = v8::String::Concat(leftSide, value->ToString());
-
-  return scope.Escape(Nan::Error(exceptionString));
-}
-
-static v8::Local<v8::Value> RfcError(const char *message, const SAP_UC *sapName) {
-  Nan::EscapableHandleScope scope;
-  v8::Local<v8::String> name = Nan::New<v8::String>((const uint16_t*)sapName).ToLocalChecked();
-
-  return scope.Escape(RfcError(message, name));
-}
-
-static bool IsException(const v8::Local<v8::Value> &value)
-{
-  return value->IsNativeError();
+static RFC_CONNECTION_PARAMETER* convertToConnectionParameters(napi_env env, napi_value optionsObj, unsigned int *paramsSize)
+{
+  napi_value props;
+  if (napi_get_property_names(env, optionsObj, &props) != napi_ok) {
+    *paramsSize = 0;
+    return nullptr;
+  }
+
+  *paramsSize = ArrayLength(env, props);
+  RFC_CONNECTION_PARAMETER *params = static_cast<RFC_CONNECTION_PARAMETER*>(malloc(*paramsSize * sizeof(RFC_CONNECTION_PARAMETER)));
+  memset(params, 0, *paramsSize * sizeof(RFC_CONNECTION_PARAMETER));
+
+  for (unsigned int i = 0; i < *paramsSize; i++) {
+    napi_value name = Get(env, props, i);
+    napi_value value = Get(env, optionsObj, name);
+
+    params[i].name = convertToSAPUC(env, name);
+    params[i].value = convertToSAPUC(env, value);
+
+#ifndef NDEBUG
+    std::cout << convertToString(env, name) << "--> " << convertToString(env, value) << std::endl;
+#endif
+  }
+
+  return params;
+}
+
+static void freeConnectionParameters(RFC_CONNECTION_PARAMETER *params, unsigned int paramsSize)
+{
+  for (unsigned int i = 0; i < paramsSize; i++) {
+     free(const_cast<SAP_UC*>(params[i].name));
+     free(const_cast<SAP_UC*>(params[i].value));
+  }
+  free(params);
+}
+
+static napi_value RfcError(napi_env env, const RFC_ERROR_INFO &info)
+{
+  napi_value e;
+  napi_create_error(env, nullptr, NewString(env, info.message), &e);
+
+  Set(env, e, "code", Int32(env, info.code));
+  Set(env, e, "group", Int32(env, info.group));
+  Set(env, e, "key", NewString(env, info.key));
+  Set(env, e, "class", NewString(env, info.abapMsgClass));
+  Set(env, e, "type", NewString(env, info.abapMsgType));
+  Set(env, e, "number", NewString(env, info.abapMsgNumber));
+  Set(env, e, "msgv1", NewString(env, info.abapMsgV1));
+  Set(env, e, "msgv2", NewString(env, info.abapMsgV2));
+  Set(env, e, "msgv3", NewString(env, info.abapMsgV3));
+  Set(env, e, "msgv4", NewString(env, info.abapMsgV4));
+
+  return e;
+}
+
+static napi_value RfcError(napi_env env, const char* message, napi_value value)
+{
+  std::string exceptionString(message);
+  exceptionString.append(convertToString(env, value));
+
+  napi_value e;
+  napi_create_error(env, nullptr, NewString(env, exceptionString.c_str()), &e);
+  return e;
+}
+
+static napi_value RfcError(napi_env env, const char *message, const SAP_UC *sapName) {
+  return RfcError(env, message, NewString(env, sapName));
+}
+
+static bool IsException(napi_env env, napi_value value)
+{
+  bool result = false;
+  napi_is_error(env, value, &result);
+  return result;
 }
 
 #endif /* COMMON_H_ */
@@ -0,0 +1,135 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#include "Common.h"
+#include "Completion.h"
+
+/**
+ * An exception thrown by a callback goes to process 'uncaughtException', like from any other callback
+ */
+static void RethrowUncaught(napi_env env)
+{
+  bool pending = false;
+  napi_is_exception_pending(env, &pending);
+  if (pending) {
+    napi_value exception;
+    napi_get_and_clear_last_exception(env, &exception);
+    napi_fatal_exception(env, exception);
+  }
+}
+
+Completion::Completion(napi_env env, napi_value callback) :
+  env(env),
+  callback(nullptr),
+  deferred(nullptr),
+  promise(nullptr)
+{
+  napi_create_reference(env, callback, 1, &this->callback);
+  this->Init();
+}
+
+Completion::Completion(napi_env env) :
+  env(env),
+  callback(nullptr),
+  deferred(nullptr),
+  promise(nullptr)
+{
+  napi_create_promise(env, &this->deferred, &this->promise);
+  this->Init();
+}
+
+void Completion::Init(void)
+{
+  napi_value resource = NewObject(this->env);
+  napi_create_reference(this->env, resource, 1, &this->resource);
+  napi_async_init(this->env, resource, NewString(this->env, "sapnwrfc"), &this->context);
+}
+
+Completion::~Completion()
+{
+  napi_async_destroy(this->env, this->context);
+  napi_delete_reference(this->env, this->resource);
+  if (this->callback != nullptr) {
+    napi_delete_reference(this->env, this->callback);
+  }
+}
+
+napi_value Completion::GetPromise()
+{
+  if (this->callback == nullptr) {
+    return this->promise;
+  }
+
+  return Undefined(this->env);
+}
+
+void Completion::Complete(int argc, napi_value argv[])
+{
+  HandleScope scope(this->env);
+  napi_value resource = Reference(this->env, this->resource);
+
+  if (this->callback != nullptr) {
+    napi_value result;
+    napi_make_callback(this->env, this->context, resource, Reference(this->env, this->callback), argc, argv, &result);
+  } else {
+    // Not called from JavaScript, closing the scope runs the reactions
+    napi_callback_scope callbackScope;
+    napi_open_callback_scope(this->env, resource, this->context, &callbackScope);
+    this->Settle(argv[0], argc > 1 ? argv[1] : Undefined(this->env));
+    napi_close_callback_scope(this->env, callbackScope);
+  }
+
+  RethrowUncaught(this->env);
+}
+
+void Completion::Fail(napi_value error)
+{
+  HandleScope scope(this->env);
+
+  if (this->callback != nullptr) {
+    napi_value argv[2];
+    argv[0] = error;
+    argv[1] = Null(this->env);
+    napi_value result;
+
+    napi_call_function(this->env, Undefined(this->env), Reference(this->env, this->callback), 2, argv, &result);
+
+    RethrowUncaught(this->env);
+    return;
+  }
+
+  this->Settle(error, Undefined(this->env));
+}
+
+void Completion::Settle(napi_value error, napi_value value)
+{
+  if (!IsNull(this->env, error)) {
+    napi_reject_deferred(this->env, this->deferred, error);
+  } else {
+    napi_resolve_deferred(this->env, this->deferred, value);
+  }
+  // Settled only once
+  this->deferred = nullptr;
+}
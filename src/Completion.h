@@ -0,0 +1,70 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#ifndef COMPLETION_H_
+#define COMPLETION_H_
+
+#include "Common.h"
+
+/**
+ * Delivers the outcome of an asynchronous operation on the main thread, either
+ * to a Node-style callback or by settling a native promise.
+ */
+class Completion
+{
+  public:
+  // Node-style callback
+  Completion(napi_env env, napi_value callback);
+  // Native promise
+  explicit Completion(napi_env env);
+  ~Completion();
+
+  // The promise to return to JavaScript, undefined for callbacks. Only valid in the call that created the completion
+  napi_value GetPromise();
+
+  // From libuv callbacks: argv[0] is the error or null, a promise resolves with argv[1] if given
+  void Complete(int argc, napi_value argv[]);
+  // From a call out of JavaScript, before any work has been queued
+  void Fail(napi_value error);
+
+  napi_env env;
+
+  protected:
+  void Settle(napi_value error, napi_value value);
+  void Init(void);
+
+  napi_ref callback;
+  napi_deferred deferred;
+  napi_value promise;
+  // Links the callback to the call that started the operation, for async_hooks and AsyncLocalStorage
+  napi_ref resource;
+  napi_async_context context;
+
+  private:
+  Completion(const Completion&);
+  Completion& operator=(const Completion&);
+};
+
+#endif /* COMPLETION_H_ */
@@ -25,11 +25,17 @@ SOFTWARE.
 #include "Common.h"
 #include "Connection.h"
 #include "Function.h"
+#include "MetadataCache.h"
+#include "AddonState.h"
+#include "WorkerPool.h"
 
 Connection::Connection() :
   loginParamsSize(0),
   loginParams(nullptr),
-  connectionHandle(nullptr)
+  connectionHandle(nullptr),
+  openCompletion(nullptr),
+  busy(false),
+  id(AddonState::Current()->connectionCount++)
 {
   uv_mutex_init(&this->invocationMutex);
 }
@@ -40,112 +46,119 @@ Connection::~Connection()
 
   uv_mutex_destroy(&this->invocationMutex);
 
-  for (unsigned int i = 0; i < this->loginParamsSize; i++) {
-     free(const_cast<SAP_UC*>(loginParams[i].name));
-     free(const_cast<SAP_UC*>(loginParams[i].value));
-  }
-  free(loginParams);
+  freeConnectionParameters(this->loginParams, this->loginParamsSize);
 
-  delete this->cbOpen;
-  this->cbOpen = nullptr;
+  delete this->openCompletion;
+  this->openCompletion = nullptr;
 }
 
-NAN_METHOD(Connection::New)
+NAPI_METHOD(Connection::New)
 {
+  CallbackInfo info(env, cbinfo);
+
   if (!info.IsConstructCall()) {
-    Nan::ThrowError("Invalid call format. Please use the 'new' operator.");
-    return;
+    return ThrowError(env, "Invalid call format. Please use the 'new' operator.");
   }
 
   Connection *self = new Connection();
-  self->Wrap(info.This());
+  self->Wrap(env, info.This());
 
-  info.GetReturnValue().Set(info.This());
+  return info.This();
 }
 
-NAN_MODULE_INIT(Connection::Init)
+void Connection::Init(napi_env env, napi_value exports)
 {
-  Nan::HandleScope scope;
-
-  v8::Local<v8::FunctionTemplate> ctorTemplate = Nan::New<v8::FunctionTemplate>(New);
-  ctorTemplate->InstanceTemplate()->SetInternalFieldCount(1);
-  ctorTemplate->SetClassName(Nan::New("Connection").ToLocalChecked());
-
-  Nan::SetPrototypeMethod(ctorTemplate, "GetVersion", Connection::GetVersion);
-  Nan::SetPrototypeMethod(ctorTemplate, "Open", Connection::Open);
-  Nan::SetPrototypeMethod(ctorTemplate, "Close", Connection::Close);
-  Nan::SetPrototypeMethod(ctorTemplate, "Ping", Connection::Ping);
-  Nan::SetPrototypeMethod(ctorTemplate, "IsOpen", Connection::IsOpen);
-  Nan::SetPrototypeMethod(ctorTemplate, "Lookup", Connection::Lookup);
-  Nan::SetPrototypeMethod(ctorTemplate, "SetIniPath", Connection::SetIniPath);
-
-  Nan::Set(target, Nan::New("Connection").ToLocalChecked(), ctorTemplate->GetFunction());
+  napi_property_descriptor methods[] = {
+    Method("GetVersion", Connection::GetVersion),
+    Method("Open", Connection::Open),
+    Method("OpenAsync", Connection::OpenAsync),
+    Method("Close", Connection::Close),
+    Method("Ping", Connection::Ping),
+    Method("PingAsync", Connection::PingAsync),
+    Method("IsOpen", Connection::IsOpen),
+    Method("Lookup", Connection::Lookup),
+    Method("LookupAsync", Connection::LookupAsync),
+    Method("SetIniPath", Connection::SetIniPath),
+    Method("Prewarm", Connection::Prewarm),
+    Method("QueueStats", Connection::QueueStats)
+  };
+
+  napi_value ctor;
+  napi_define_class(env, "Connection", NAPI_AUTO_LENGTH, New, nullptr,
+                    sizeof(methods) / sizeof(methods[0]), methods, &ctor);
+
+  Set(env, exports, "Connection", ctor);
 }
 
 /**
  * @return Array
  */
-NAN_METHOD(Connection::GetVersion)
+NAPI_METHOD(Connection::GetVersion)
 {
   unsigned majorVersion, minorVersion, patchLevel;
 
   RfcGetVersion(&majorVersion, &minorVersion, &patchLevel);
-  v8::Local<v8::Array> versionInfo = Nan::New<v8::Array>(3);
+  napi_value versionInfo = NewArray(env, 3);
 
-  versionInfo->Set(0, Nan::New<v8::Integer>(majorVersion));
-  versionInfo->Set(1, Nan::New<v8::Integer>(minorVersion));
-  versionInfo->Set(2, Nan::New<v8::Integer>(patchLevel));
+  Set(env, versionInfo, 0u, Uint32(env, majorVersion));
+  Set(env, versionInfo, 1u, Uint32(env, minorVersion));
+  Set(env, versionInfo, 2u, Uint32(env, patchLevel));
 
-  info.GetReturnValue().Set(versionInfo);
+  return versionInfo;
 }
 
-NAN_METHOD(Connection::Open)
+NAPI_METHOD(Connection::Open)
 {
-  Connection *self = node::ObjectWrap::Unwrap<Connection>(info.This());
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
 
   if (info.Length() < 2) {
-    Nan::ThrowError("Function expects 2 arguments");
-    return;
+    return ThrowError(env, "Function expects 2 arguments");
   }
-  if (!info[0]->IsObject()) {
-    Nan::ThrowError("Argument 1 must be an object");
-    return;
+  if (!IsObject(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an object");
   }
-  if (!info[1]->IsFunction()) {
-    Nan::ThrowError("Argument 2 must be a function");
-    return;
+  if (!IsFunction(env, info[1])) {
+    return ThrowError(env, "Argument 2 must be a function");
   }
 
-  v8::Local<v8::Object> optionsObj = info[0]->ToObject();
-  v8::Local<v8::Array> props = optionsObj->GetPropertyNames();
+  self->QueueOpen(info[0], new Completion(env, info[1]));
+  return nullptr;
+}
 
-  self->loginParamsSize = props->Length();
-  self->loginParams = static_cast<RFC_CONNECTION_PARAMETER*>(malloc(self->loginParamsSize * sizeof(RFC_CONNECTION_PARAMETER)));
-  memset(self->loginParams, 0, self->loginParamsSize * sizeof(RFC_CONNECTION_PARAMETER));
-  memset(&self->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+/**
+ * OpenAsync(connectionParameters) returns a promise, resolved once the connection is open
+ */
+NAPI_METHOD(Connection::OpenAsync)
+{
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
 
-  for (unsigned int i = 0; i < self->loginParamsSize; i++) {
-    v8::Local<v8::Value> name = props->Get(i);
-    v8::Local<v8::Value> value = optionsObj->Get(name->ToString());
+  if (info.Length() != 1) {
+    return ThrowError(env, "Function expects 1 argument");
+  }
+  if (!IsObject(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an object");
+  }
 
-    self->loginParams[i].name = convertToSAPUC(name);
-    self->loginParams[i].value = convertToSAPUC(value);
+  Completion *completion = new Completion(env);
+  napi_value promise = completion->GetPromise();
+  self->QueueOpen(info[0], completion);
 
-#ifndef NDEBUG
-    std::cout << convertToString(name) << "--> " << convertToString(value) << std::endl;
-#endif
-  }
+  return promise;
+}
 
-  // Store callback
-  self->cbOpen = new Nan::Callback(v8::Local<v8::Function>::Cast(info[1]));
-  self->Ref();
+void Connection::QueueOpen(napi_value optionsObj, Completion *completion)
+{
+  this->loginParams = convertToConnectionParameters(this->env, optionsObj, &this->loginParamsSize);
+  memset(&this->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+
+  this->openCompletion = completion;
+  this->Ref();
 
   uv_work_t* req = new uv_work_t();
-  req->data = self;
-  uv_queue_work(uv_default_loop(), req, EIO_Open, (uv_after_work_cb)EIO_AfterOpen);
-#if !NODE_VERSION_AT_LEAST(0, 7, 9)
-    uv_ref(uv_default_loop());
-#endif
+  req->data = this;
+  WorkerPool::Queue(req, EIO_Open, (uv_after_work_cb)EIO_AfterOpen, this->id);
 }
 
 void Connection::EIO_Open(uv_work_t *req)
@@ -157,56 +170,250 @@ void Connection::EIO_Open(uv_work_t *req)
 
 void Connection::EIO_AfterOpen(uv_work_t *req)
 {
-  Nan::HandleScope scope;
   RFC_ERROR_INFO errorInfo;
   int isValid;
   Connection *self = static_cast<Connection*>(req->data);
+  napi_env env = self->env;
+  HandleScope scope(env);
 
-  v8::Local<v8::Value> argv[1];
-  argv[0] = Nan::Null();
+  napi_value argv[1];
+  argv[0] = Null(env);
 
   if (self->connectionHandle == nullptr) {
-    argv[0] = RfcError(self->errorInfo);
+    argv[0] = RfcError(env, self->errorInfo);
   } else {
     RfcIsConnectionHandleValid(self->connectionHandle, &isValid, &errorInfo);
     if (!isValid) {
-      argv[0] = RfcError(errorInfo);
+      argv[0] = RfcError(env, errorInfo);
     }
   }
 
-  Nan::TryCatch try_catch;
+  Completion *completion = self->openCompletion;
+  self->openCompletion = nullptr;
 
-  assert(!self->cbOpen->IsEmpty());
-  self->cbOpen->Call(1, argv);
-  delete self->cbOpen;
-  self->cbOpen = nullptr;
+  completion->Complete(1, argv);
+  delete completion;
   self->Unref();
+  delete req;
+}
+
+/**
+ * Close([callback(errorObject)]), closes on the thread pool if a callback is given
+ */
+NAPI_METHOD(Connection::Close)
+{
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
 
-  if (try_catch.HasCaught()) {
-    Nan::FatalException(try_catch);
+  if (info.Length() > 0) {
+    if (!IsFunction(env, info[0])) {
+      return ThrowError(env, "Argument 1 must be a function");
+    }
+    OperationBaton *baton = new OperationBaton();
+    baton->completion = new Completion(env, info[0]);
+    baton->connection = self;
+    self->Ref();
+
+    // Behind everything that has been queued so far, whatever is queued later fails on the closed handle
+    uv_work_t* req = new uv_work_t();
+    req->data = baton;
+    self->EnqueueBarrier(req, EIO_Close, (uv_after_work_cb)EIO_AfterClose);
+    return nullptr;
   }
+
+  self->CloseConnection();
+  return Boolean(env, true);
 }
 
-NAN_METHOD(Connection::Close)
+void Connection::EIO_Close(uv_work_t *req)
 {
-  Connection *self = node::ObjectWrap::Unwrap<Connection>(info.This());
-  info.GetReturnValue().Set(self->CloseConnection());
+  OperationBaton *baton = static_cast<OperationBaton*>(req->data);
+  Connection *self = baton->connection;
+
+  // A pending invocation finishes first, later ones fail on the closed handle
+  self->LockMutex();
+  if (self->connectionHandle != nullptr) {
+    RfcCloseConnection(self->connectionHandle, &baton->errorInfo);
+    self->connectionHandle = nullptr;
+  }
+  self->UnlockMutex();
 }
 
-v8::Local<v8::Value> Connection::CloseConnection(void)
+void Connection::EIO_AfterClose(uv_work_t *req)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  OperationBaton *baton = static_cast<OperationBaton*>(req->data);
+  napi_env env = baton->connection->env;
+  HandleScope scope(env);
 
-  if (this->connectionHandle != nullptr) {
-    rc = RfcCloseConnection(this->connectionHandle, &errorInfo);
-    if (rc != RFC_OK) {
-      scope.Escape(RfcError(errorInfo));
+  napi_value argv[1];
+  argv[0] = Null(env);
+
+  if (baton->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, baton->errorInfo);
+  }
+
+  baton->completion->Complete(1, argv);
+  delete baton;
+  delete req;
+}
+
+/**
+ * Runs one of the connection operations on the thread pool, takes over the completion
+ */
+void Connection::QueueOperation(uv_work_cb work, uv_after_work_cb afterWork, Priority priority, Completion *completion)
+{
+  OperationBaton *baton = new OperationBaton();
+  baton->completion = completion;
+  baton->connection = this;
+  this->Ref();
+
+  uv_work_t* req = new uv_work_t();
+  req->data = baton;
+  this->Enqueue(req, work, afterWork, priority);
+}
+
+void Connection::Enqueue(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork, Priority priority)
+{
+  // Released once the task has completed
+  this->Ref();
+  this->lanes[priority].push_back(QueuedTask(req, work, afterWork));
+
+  if (!this->busy) {
+    this->DispatchNext();
+  }
+}
+
+void Connection::EnqueueBarrier(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork)
+{
+  // Released once the task has completed
+  this->Ref();
+
+  // Everything queued so far keeps its order by lane, then the barrier
+  for (unsigned int i = 0; i < PRIORITY_LANES; i++) {
+    this->draining.insert(this->draining.end(), this->lanes[i].begin(), this->lanes[i].end());
+    this->lanes[i].clear();
+  }
+  this->draining.push_back(QueuedTask(req, work, afterWork));
+
+  if (!this->busy) {
+    this->DispatchNext();
+  }
+}
+
+/**
+ * The after work callback of a cancelled task runs with UV_ECANCELED on the next turn of the loop
+ */
+bool Connection::Cancel(uv_work_t *req)
+{
+  QueuedTask task;
+
+  bool found = Remove(this->draining, req, task);
+  for (unsigned int i = 0; !found && i < PRIORITY_LANES; i++) {
+    found = Remove(this->lanes[i], req, task);
+  }
+  if (!found) {
+    return false;
+  }
+
+  WorkerPool::Complete(task.req, task.afterWork, UV_ECANCELED);
+
+  // The task never uses the connection now
+  this->Unref();
+  return true;
+}
+
+bool Connection::Remove(std::deque<QueuedTask> &queue, uv_work_t *req, QueuedTask &task)
+{
+  for (std::deque<QueuedTask>::iterator it = queue.begin(); it != queue.end(); ++it) {
+    if (it->req == req) {
+      task = *it;
+      queue.erase(it);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Hands the next task to the thread pool: first those ahead of a barrier,
+ * then the oldest task of the highest non-empty lane
+ */
+void Connection::DispatchNext(void)
+{
+  if (!this->draining.empty()) {
+    this->running = this->draining.front();
+    this->draining.pop_front();
+    this->busy = true;
+
+    this->worker.data = this;
+    WorkerPool::Queue(&this->worker, EIO_RunTask, EIO_AfterRunTask, this->id);
+    return;
+  }
+
+  for (unsigned int i = 0; i < PRIORITY_LANES; i++) {
+    if (!this->lanes[i].empty()) {
+      this->running = this->lanes[i].front();
+      this->lanes[i].pop_front();
+      this->busy = true;
+
+      this->worker.data = this;
+      WorkerPool::Queue(&this->worker, EIO_RunTask, EIO_AfterRunTask, this->id);
+      return;
     }
   }
+}
+
+void Connection::EIO_RunTask(uv_work_t *req)
+{
+  Connection *self = static_cast<Connection*>(req->data);
+
+  self->running.work(self->running.req);
+}
+
+void Connection::EIO_AfterRunTask(uv_work_t *req, int status)
+{
+  Connection *self = static_cast<Connection*>(req->data);
+  QueuedTask task = self->running;
+
+  // Start the next task first, so that it runs while JavaScript handles the result of this one
+  self->busy = false;
+  self->DispatchNext();
+
+  task.afterWork(task.req, status);
+  self->Unref();
+}
+
+/**
+ * @return Object with the number of running and pending tasks, in total and per lane
+ */
+NAPI_METHOD(Connection::QueueStats)
+{
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
+
+  unsigned int pending = self->draining.size();
+  for (unsigned int i = 0; i < PRIORITY_LANES; i++) {
+    pending += self->lanes[i].size();
+  }
+
+  napi_value stats = NewObject(env);
+  Set(env, stats, "running", Uint32(env, self->busy ? 1 : 0));
+  Set(env, stats, "pending", Uint32(env, pending));
+  Set(env, stats, "high", Uint32(env, (unsigned int)self->lanes[PRIORITY_HIGH].size()));
+  Set(env, stats, "normal", Uint32(env, (unsigned int)self->lanes[PRIORITY_NORMAL].size()));
+  Set(env, stats, "low", Uint32(env, (unsigned int)self->lanes[PRIORITY_LOW].size()));
 
-  return scope.Escape(Nan::True());
+  return stats;
+}
+
+void Connection::CloseConnection(void)
+{
+  RFC_ERROR_INFO errorInfo;
+
+  if (this->connectionHandle != nullptr) {
+    RfcCloseConnection(this->connectionHandle, &errorInfo);
+  }
 }
 
 RFC_CONNECTION_HANDLE Connection::GetConnectionHandle(void)
@@ -224,30 +431,74 @@ void Connection::UnlockMutex(void)
   uv_mutex_unlock(&this->invocationMutex);
 }
 
-NAN_METHOD(Connection::IsOpen)
+/**
+ * IsOpen([callback(errorObject, isOpen)]), checks on the thread pool if a callback is given
+ */
+NAPI_METHOD(Connection::IsOpen)
 {
-  Connection *self = node::ObjectWrap::Unwrap<Connection>(info.This());
-  RFC_RC rc = RFC_OK;
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
   RFC_ERROR_INFO errorInfo;
   int isValid;
 
-  rc = RfcIsConnectionHandleValid(self->connectionHandle, &isValid, &errorInfo);
-  info.GetReturnValue().Set(isValid ? Nan::True() : Nan::False());
+  if (info.Length() > 0) {
+    if (!IsFunction(env, info[0])) {
+      return ThrowError(env, "Argument 1 must be a function");
+    }
+    self->QueueOperation(EIO_IsOpen, (uv_after_work_cb)EIO_AfterIsOpen, PRIORITY_HIGH, new Completion(env, info[0]));
+    return nullptr;
+  }
+
+  RfcIsConnectionHandleValid(self->connectionHandle, &isValid, &errorInfo);
+  return Boolean(env, isValid);
+}
+
+void Connection::EIO_IsOpen(uv_work_t *req)
+{
+  OperationBaton *baton = static_cast<OperationBaton*>(req->data);
+  RFC_ERROR_INFO errorInfo;
+
+  baton->connection->LockMutex();
+  RfcIsConnectionHandleValid(baton->connection->GetConnectionHandle(), &baton->isValid, &errorInfo);
+  baton->connection->UnlockMutex();
+}
+
+void Connection::EIO_AfterIsOpen(uv_work_t *req)
+{
+  OperationBaton *baton = static_cast<OperationBaton*>(req->data);
+  napi_env env = baton->connection->env;
+  HandleScope scope(env);
+
+  napi_value argv[2];
+  argv[0] = Null(env);
+  argv[1] = Boolean(env, baton->isValid);
+
+  baton->completion->Complete(2, argv);
+  delete baton;
+  delete req;
 }
 
 /**
+ * Ping([callback(errorObject)]), pings on the thread pool if a callback is given
  *
  * @return true if successful, else: RfcException
  */
-NAN_METHOD(Connection::Ping)
+NAPI_METHOD(Connection::Ping)
 {
-  Connection *self = node::ObjectWrap::Unwrap<Connection>(info.This());
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
   RFC_RC rc = RFC_OK;
   RFC_ERROR_INFO errorInfo;
 
-  if (info.Length() > 0) {
-    Nan::ThrowError("No arguments expected");
-    return;
+  if (info.Length() > 1) {
+    return ThrowError(env, "Function expects 1 argument");
+  }
+  if (info.Length() == 1) {
+    if (!IsFunction(env, info[0])) {
+      return ThrowError(env, "Argument 1 must be a function");
+    }
+    self->QueueOperation(EIO_Ping, (uv_after_work_cb)EIO_AfterPing, PRIORITY_HIGH, new Completion(env, info[0]));
+    return nullptr;
   }
 
   rc = RfcPing(self->connectionHandle, &errorInfo);
@@ -255,67 +506,227 @@ NAN_METHOD(Connection::Ping)
     RETURN_RFC_ERROR(errorInfo);
   }
 
-  info.GetReturnValue().Set(Nan::True());
+  return Boolean(env, true);
+}
+
+/**
+ * PingAsync() returns a promise, the ping runs on the thread pool
+ */
+NAPI_METHOD(Connection::PingAsync)
+{
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
+
+  if (info.Length() > 0) {
+    return ThrowError(env, "No arguments expected");
+  }
+
+  Completion *completion = new Completion(env);
+  napi_value promise = completion->GetPromise();
+  self->QueueOperation(EIO_Ping, (uv_after_work_cb)EIO_AfterPing, PRIORITY_HIGH, completion);
+
+  return promise;
+}
+
+void Connection::EIO_Ping(uv_work_t *req)
+{
+  OperationBaton *baton = static_cast<OperationBaton*>(req->data);
+
+  // Wait for running invocations, they own the connection meanwhile
+  baton->connection->LockMutex();
+  RfcPing(baton->connection->GetConnectionHandle(), &baton->errorInfo);
+  baton->connection->UnlockMutex();
+}
+
+void Connection::EIO_AfterPing(uv_work_t *req)
+{
+  OperationBaton *baton = static_cast<OperationBaton*>(req->data);
+  napi_env env = baton->connection->env;
+  HandleScope scope(env);
+
+  napi_value argv[2];
+  argv[0] = Null(env);
+  argv[1] = Boolean(env, true);
+
+  if (baton->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, baton->errorInfo);
+    argv[1] = Null(env);
+  }
+
+  baton->completion->Complete(2, argv);
+  delete baton;
+  delete req;
 }
 
 /**
  *
  * @return Function
  */
-NAN_METHOD(Connection::Lookup)
+NAPI_METHOD(Connection::Lookup)
 {
-  RFC_RC rc = RFC_OK;
+  CallbackInfo info(env, cbinfo);
   RFC_ERROR_INFO errorInfo;
   int isValid;
 
-  Connection *self = node::ObjectWrap::Unwrap<Connection>(info.This());
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
 
   if (info.Length() != 1) {
-    Nan::ThrowError("Function expects 1 argument");
-    return;
+    return ThrowError(env, "Function expects 1 argument");
   }
-  if (!info[0]->IsString()) {
-    Nan::ThrowError("Argument 1 must be function module name");
-    return;
+  if (!IsString(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be function module name");
   }
 
-  rc = RfcIsConnectionHandleValid(self->connectionHandle, &isValid, &errorInfo);
+  RfcIsConnectionHandleValid(self->connectionHandle, &isValid, &errorInfo);
   if (!isValid) {
-    Nan::ThrowError(RfcError(errorInfo));
-    return;
+    return Throw(env, RfcError(env, errorInfo));
+  }
+
+  return Function::NewInstance(*self, info[0]);
+}
+
+/**
+ * LookupAsync(functionModuleName, [callback(errorObject, functionObject)]), returns a promise without a callback
+ */
+NAPI_METHOD(Connection::LookupAsync)
+{
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
+
+  if (info.Length() < 1 || info.Length() > 2) {
+    return ThrowError(env, "Function expects 1 or 2 arguments");
+  }
+  if (!IsString(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be function module name");
   }
 
-  v8::Local<v8::Value> f = Function::NewInstance(*self, info);
-  info.GetReturnValue().Set(f);
+  // Without a callback, a promise of the Function object is returned
+  if (info.Length() < 2 || IsUndefined(env, info[1])) {
+    Completion *completion = new Completion(env);
+    napi_value promise = completion->GetPromise();
+    Function::LookupAsync(self, nullptr, info[0], completion);
+    return promise;
+  }
+  if (!IsFunction(env, info[1])) {
+    return ThrowError(env, "Argument 2 must be a function");
+  }
+
+  Function::LookupAsync(self, nullptr, info[0], new Completion(env, info[1]));
+  return nullptr;
 }
 
 /**
  *
  * @return true if successful, else: RfcException
  */
-NAN_METHOD(Connection::SetIniPath)
+NAPI_METHOD(Connection::SetIniPath)
 {
+  CallbackInfo info(env, cbinfo);
   RFC_RC rc = RFC_OK;
   RFC_ERROR_INFO errorInfo;
-  
-  Connection *self = node::ObjectWrap::Unwrap<Connection>(info.This());
 
   if (info.Length() != 1) {
-    Nan::ThrowError("Function expects 1 argument");
-    return;
+    return ThrowError(env, "Function expects 1 argument");
   }
-  if (!info[0]->IsString()) {
-    Nan::ThrowError("Argument 1 must be a path name");
-    return;
+  if (!IsString(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be a path name");
   }
 
-  v8::Local<v8::Value> iniPath = info[0]->ToString();
-
-  rc = RfcSetIniPath(convertToSAPUC(iniPath), &errorInfo);
+  SAP_UC *iniPath = convertToSAPUC(env, info[0]);
+  rc = RfcSetIniPath(iniPath, &errorInfo);
+  free(iniPath);
   if (rc) {
-    Nan::ThrowError(RfcError(errorInfo));
-    return;
+    return Throw(env, RfcError(env, errorInfo));
+  }
+
+  return Boolean(env, true);
+}
+
+/**
+ * Prewarm(functionModuleNames, callback)
+ *
+ * Fetches the descriptions of the given function modules into the metadata
+ * cache, so that subsequent lookups are served from memory.
+ */
+NAPI_METHOD(Connection::Prewarm)
+{
+  CallbackInfo info(env, cbinfo);
+  Connection *self = ObjectWrap::Unwrap<Connection>(env, info.This());
+
+  if (info.Length() != 2) {
+    return ThrowError(env, "Function expects 2 arguments");
+  }
+  if (!IsArray(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an array of function module names");
+  }
+  if (!IsFunction(env, info[1])) {
+    return ThrowError(env, "Argument 2 must be a function");
+  }
+
+  napi_value names = info[0];
+  uint32_t count = ArrayLength(env, names);
+  for (unsigned int i = 0; i < count; i++) {
+    if (!IsString(env, Get(env, names, i))) {
+      return ThrowError(env, "Argument 1 must be an array of function module names");
+    }
+  }
+
+  PrewarmBaton *baton = new PrewarmBaton();
+  memset(&baton->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+
+  for (unsigned int i = 0; i < count; i++) {
+    baton->functionNames.push_back(convertToSAPUC(env, Get(env, names, i)));
+  }
+
+  baton->completion = new Completion(env, info[1]);
+  baton->connection = self;
+  self->Ref();
+
+  uv_work_t* req = new uv_work_t();
+  req->data = baton;
+  self->Enqueue(req, EIO_Prewarm, (uv_after_work_cb)EIO_AfterPrewarm, PRIORITY_LOW);
+  return nullptr;
+}
+
+void Connection::EIO_Prewarm(uv_work_t *req)
+{
+  PrewarmBaton *baton = static_cast<PrewarmBaton*>(req->data);
+  RFC_ERROR_INFO errorInfo;
+
+  baton->connection->LockMutex();
+
+  for (unsigned int i = 0; i < baton->functionNames.size(); i++) {
+    RFC_FUNCTION_DESC_HANDLE functionDescHandle = MetadataCache::GetFunctionDesc(
+      baton->connection->GetConnectionHandle(), baton->functionNames[i], &errorInfo);
+
+    // Report the first failure, but keep on fetching the others
+    if (functionDescHandle == nullptr && baton->errorInfo.code == RFC_OK) {
+      baton->errorInfo = errorInfo;
+    }
+
+    // Stays cached, nothing uses it yet
+    if (functionDescHandle != nullptr) {
+      MetadataCache::Release(functionDescHandle);
+    }
+  }
+
+  baton->connection->UnlockMutex();
+}
+
+void Connection::EIO_AfterPrewarm(uv_work_t *req)
+{
+  PrewarmBaton *baton = static_cast<PrewarmBaton*>(req->data);
+  napi_env env = baton->connection->env;
+  HandleScope scope(env);
+
+  napi_value argv[1];
+  argv[0] = Null(env);
+
+  if (baton->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, baton->errorInfo);
   }
 
-  info.GetReturnValue().Set(Nan::True());
+  baton->completion->Complete(1, argv);
+  delete baton;
+  delete req;
 }
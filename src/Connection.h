@@ -26,38 +26,76 @@ SOFTWARE.
 #define CONNECTION_H_
 
 #include "Common.h"
-#include <v8.h>
-#include <node.h>
-#include <node_version.h>
+#include "Completion.h"
+#include "ObjectWrap.h"
 #include <uv.h>
 #include <sapnwrfc.h>
 #include <iostream>
+#include <deque>
+#include <vector>
 
-class Connection : public node::ObjectWrap
+class Connection : public ObjectWrap
 {
+  friend class Cancellation;
   friend class Function;
 
   public:
 
-    static NAN_MODULE_INIT(Init);
+    static void Init(napi_env env, napi_value exports);
+
+    // Lanes of the invocation queue, drained in this order
+    enum Priority {
+      PRIORITY_HIGH,
+      PRIORITY_NORMAL,
+      PRIORITY_LOW,
+      PRIORITY_LANES
+    };
 
   protected:
 
     Connection();
     ~Connection();
-    static NAN_METHOD(GetVersion);
-    static NAN_METHOD(New);
-    static NAN_METHOD(Open);
-    static NAN_METHOD(Close);
-    static NAN_METHOD(Ping);
-    static NAN_METHOD(Lookup);
-    static NAN_METHOD(IsOpen);
-    static NAN_METHOD(SetIniPath);
+    static NAPI_METHOD(GetVersion);
+    static NAPI_METHOD(New);
+    static NAPI_METHOD(Open);
+    static NAPI_METHOD(OpenAsync);
+    static NAPI_METHOD(Close);
+    static NAPI_METHOD(Ping);
+    static NAPI_METHOD(PingAsync);
+    static NAPI_METHOD(Lookup);
+    static NAPI_METHOD(LookupAsync);
+    static NAPI_METHOD(IsOpen);
+    static NAPI_METHOD(SetIniPath);
+    static NAPI_METHOD(Prewarm);
+    static NAPI_METHOD(QueueStats);
 
     static void EIO_Open(uv_work_t *req);
     static void EIO_AfterOpen(uv_work_t *req);
-
-    v8::Local<v8::Value> CloseConnection(void);
+    static void EIO_Ping(uv_work_t *req);
+    static void EIO_AfterPing(uv_work_t *req);
+    static void EIO_IsOpen(uv_work_t *req);
+    static void EIO_AfterIsOpen(uv_work_t *req);
+    static void EIO_Close(uv_work_t *req);
+    static void EIO_AfterClose(uv_work_t *req);
+    static void EIO_Prewarm(uv_work_t *req);
+    static void EIO_AfterPrewarm(uv_work_t *req);
+    static void EIO_RunTask(uv_work_t *req);
+    static void EIO_AfterRunTask(uv_work_t *req, int status);
+
+    class OperationBaton;
+
+    void QueueOpen(napi_value optionsObj, Completion *completion);
+    void QueueOperation(uv_work_cb work, uv_after_work_cb afterWork, Priority priority, Completion *completion);
+
+    // Main thread only, queues work that uses the connection, one task runs at a time
+    void Enqueue(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork, Priority priority = PRIORITY_NORMAL);
+    // Main thread only, runs after all tasks queued so far and before any task queued later
+    void EnqueueBarrier(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork);
+    // Main thread only, takes out a task that has not been dispatched yet
+    bool Cancel(uv_work_t *req);
+    void DispatchNext(void);
+    // Does not touch JavaScript, also called by the finalizer
+    void CloseConnection(void);
 
     RFC_CONNECTION_HANDLE GetConnectionHandle(void);
     void LockMutex(void);
@@ -67,9 +105,80 @@ class Connection : public node::ObjectWrap
     RFC_CONNECTION_PARAMETER *loginParams;
     RFC_ERROR_INFO errorInfo;
     RFC_CONNECTION_HANDLE connectionHandle;
-    Nan::Callback *cbOpen;
+    Completion *openCompletion;
 
     uv_mutex_t invocationMutex;
+
+    class QueuedTask
+    {
+      public:
+      QueuedTask() : req(nullptr), work(nullptr), afterWork(nullptr) { };
+      QueuedTask(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork) : req(req), work(work), afterWork(afterWork) { };
+
+      uv_work_t *req;
+      uv_work_cb work;
+      uv_after_work_cb afterWork;
+    };
+
+    static bool Remove(std::deque<QueuedTask> &queue, uv_work_t *req, QueuedTask &task);
+
+    // Tasks wait here instead of blocking a thread of the pool on the mutex
+    std::deque<QueuedTask> lanes[PRIORITY_LANES];
+    // Tasks queued before a barrier, followed by the barrier, run ahead of the lanes
+    std::deque<QueuedTask> draining;
+    QueuedTask running;
+    bool busy;
+    uv_work_t worker;
+
+    // Selects the worker thread if the worker pool binds connections to threads
+    unsigned int id;
+
+    /**
+     * Ping, IsOpen or Close on the thread pool, serialized with invocations
+     */
+    class OperationBaton
+    {
+      public:
+      OperationBaton() : connection(nullptr), completion(nullptr), isValid(0) {
+        memset(&this->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+      };
+      ~OperationBaton() {
+        if (this->connection) {
+          this->connection->Unref();
+        }
+
+        delete this->completion;
+        this->completion = nullptr;
+      };
+
+      Connection *connection;
+      Completion *completion;
+      RFC_ERROR_INFO errorInfo;
+      int isValid;
+    };
+
+    class PrewarmBaton
+    {
+      public:
+      PrewarmBaton() : connection(nullptr), completion(nullptr) { };
+      ~PrewarmBaton() {
+        for (unsigned int i = 0; i < this->functionNames.size(); i++) {
+          free(this->functionNames[i]);
+        }
+
+        if (this->connection) {
+          this->connection->Unref();
+        }
+
+        delete this->completion;
+        this->completion = nullptr;
+      };
+
+      Connection *connection;
+      std::vector<SAP_UC*> functionNames;
+      Completion *completion;
+      RFC_ERROR_INFO errorInfo;
+    };
 };
 
 #endif /* CONNECTION_H_ */
@@ -0,0 +1,653 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Common.h"
+#include "ConnectionPool.h"
+#include "Function.h"
+#include "WorkerPool.h"
+
+#define POOL_DEFAULT_MIN_SIZE 1
+#define POOL_DEFAULT_MAX_SIZE 10
+#define POOL_DEFAULT_IDLE_TIMEOUT 300000
+#define POOL_DEFAULT_HEALTH_CHECK_INTERVAL 60000
+
+static unsigned int GetUintOption(napi_env env, napi_value options, const char *name, unsigned int defaultValue)
+{
+  napi_value value = Get(env, options, name);
+  if (!IsUint32(env, value)) {
+    return defaultValue;
+  }
+
+  return Uint32Value(env, value);
+}
+
+static void SetPoolClosedError(RFC_ERROR_INFO *errorInfo)
+{
+  memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  errorInfo->code = RFC_INVALID_HANDLE;
+  errorInfo->group = EXTERNAL_RUNTIME_FAILURE;
+  strncpyU(errorInfo->key, cU("RFC_INVALID_HANDLE"), sizeof(errorInfo->key) / sizeof(SAP_UC) - 1);
+  strncpyU(errorInfo->message, cU("Connection pool is closed"), sizeof(errorInfo->message) / sizeof(SAP_UC) - 1);
+}
+
+static void SetNoIdleConnectionError(RFC_ERROR_INFO *errorInfo)
+{
+  memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  errorInfo->code = RFC_ILLEGAL_STATE;
+  errorInfo->group = EXTERNAL_RUNTIME_FAILURE;
+  strncpyU(errorInfo->key, cU("RFC_ILLEGAL_STATE"), sizeof(errorInfo->key) / sizeof(SAP_UC) - 1);
+  strncpyU(errorInfo->message, cU("No idle connection in the pool, use LookupAsync"), sizeof(errorInfo->message) / sizeof(SAP_UC) - 1);
+}
+
+static void CloseConnectionHandles(std::vector<RFC_CONNECTION_HANDLE> &connectionHandles)
+{
+  RFC_ERROR_INFO errorInfo;
+
+  for (std::vector<RFC_CONNECTION_HANDLE>::iterator it = connectionHandles.begin(); it != connectionHandles.end(); ++it) {
+    RfcCloseConnection(*it, &errorInfo);
+  }
+  connectionHandles.clear();
+}
+
+ConnectionPool::ConnectionPool() :
+  openCompletion(nullptr),
+  reapTimer(nullptr),
+  minSize(POOL_DEFAULT_MIN_SIZE),
+  maxSize(POOL_DEFAULT_MAX_SIZE),
+  idleTimeout(POOL_DEFAULT_IDLE_TIMEOUT),
+  healthCheckInterval(POOL_DEFAULT_HEALTH_CHECK_INTERVAL),
+  size(0),
+  closed(true)
+{
+  uv_mutex_init(&this->poolMutex);
+}
+
+ConnectionPool::~ConnectionPool()
+{
+  this->CloseConnections();
+
+  if (this->reapTimer != nullptr) {
+    uv_timer_stop(this->reapTimer);
+    uv_close(reinterpret_cast<uv_handle_t*>(this->reapTimer), OnReapTimerClose);
+    this->reapTimer = nullptr;
+  }
+
+  uv_mutex_destroy(&this->poolMutex);
+
+  delete this->openCompletion;
+  this->openCompletion = nullptr;
+}
+
+NAPI_METHOD(ConnectionPool::New)
+{
+  CallbackInfo info(env, cbinfo);
+
+  if (!info.IsConstructCall()) {
+    return ThrowError(env, "Invalid call format. Please use the 'new' operator.");
+  }
+
+  ConnectionPool *self = new ConnectionPool();
+  self->Wrap(env, info.This());
+
+  return info.This();
+}
+
+void ConnectionPool::Init(napi_env env, napi_value exports)
+{
+  napi_property_descriptor methods[] = {
+    Method("Open", ConnectionPool::Open),
+    Method("Close", ConnectionPool::Close),
+    Method("Lookup", ConnectionPool::Lookup),
+    Method("LookupAsync", ConnectionPool::LookupAsync),
+    Method("Stats", ConnectionPool::Stats)
+  };
+
+  napi_value ctor;
+  napi_define_class(env, "ConnectionPool", NAPI_AUTO_LENGTH, New, nullptr,
+                    sizeof(methods) / sizeof(methods[0]), methods, &ctor);
+
+  Set(env, exports, "ConnectionPool", ctor);
+}
+
+/**
+ * Open(connectionParameters, [options], callback)
+ *
+ * options: min, max, idleTimeout (ms), healthCheckInterval (ms)
+ */
+NAPI_METHOD(ConnectionPool::Open)
+{
+  CallbackInfo info(env, cbinfo);
+  ConnectionPool *self = ObjectWrap::Unwrap<ConnectionPool>(env, info.This());
+  napi_value poolOptions = NewObject(env);
+  napi_value callback;
+
+  if (info.Length() < 2) {
+    return ThrowError(env, "Function expects 2 or 3 arguments");
+  }
+  if (!IsObject(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an object");
+  }
+  if (info.Length() > 2) {
+    if (!IsObject(env, info[1])) {
+      return ThrowError(env, "Argument 2 must be an object");
+    }
+    poolOptions = info[1];
+    callback = info[2];
+  } else {
+    callback = info[1];
+  }
+  if (!IsFunction(env, callback)) {
+    return ThrowError(env, "Last argument must be a function");
+  }
+
+  // A closed pool, or one that failed to open, may be opened again
+  uv_mutex_lock(&self->poolMutex);
+  bool opened = !self->closed;
+  uv_mutex_unlock(&self->poolMutex);
+  if (opened || self->openCompletion != nullptr) {
+    return ThrowError(env, "Connection pool has already been opened");
+  }
+
+  self->minSize = GetUintOption(env, poolOptions, "min", POOL_DEFAULT_MIN_SIZE);
+  self->maxSize = GetUintOption(env, poolOptions, "max", POOL_DEFAULT_MAX_SIZE);
+  self->idleTimeout = GetUintOption(env, poolOptions, "idleTimeout", POOL_DEFAULT_IDLE_TIMEOUT);
+  self->healthCheckInterval = GetUintOption(env, poolOptions, "healthCheckInterval", POOL_DEFAULT_HEALTH_CHECK_INTERVAL);
+
+  if (self->maxSize < 1) {
+    self->maxSize = 1;
+  }
+  if (self->minSize > self->maxSize) {
+    self->minSize = self->maxSize;
+  }
+
+  std::shared_ptr<LoginParameters> loginParams(new LoginParameters(env, info[0]));
+  memset(&self->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+
+  uv_mutex_lock(&self->poolMutex);
+  self->loginParams = loginParams;
+  self->closed = false;
+  uv_mutex_unlock(&self->poolMutex);
+
+  if (self->reapTimer == nullptr) {
+    uv_loop_t *loop = nullptr;
+    napi_get_uv_event_loop(env, &loop);
+
+    self->reapTimer = new uv_timer_t();
+    uv_timer_init(loop, self->reapTimer);
+    self->reapTimer->data = self;
+    // An open pool does not keep the process alive
+    uv_unref(reinterpret_cast<uv_handle_t*>(self->reapTimer));
+  }
+  // Idle connections expire at most twice the idle timeout after their last use
+  if (self->idleTimeout > 0) {
+    uv_timer_start(self->reapTimer, OnReapTimer, self->idleTimeout, self->idleTimeout);
+  }
+
+  self->openCompletion = new Completion(env, callback);
+  self->Ref();
+
+  uv_work_t* req = new uv_work_t();
+  req->data = self;
+  WorkerPool::Queue(req, EIO_Open, (uv_after_work_cb)EIO_AfterOpen);
+  return nullptr;
+}
+
+void ConnectionPool::EIO_Open(uv_work_t *req)
+{
+  ConnectionPool *self = static_cast<ConnectionPool*>(req->data);
+
+  // Open at least one connection, so that invalid login parameters are reported right away
+  unsigned int count = self->minSize > 0 ? self->minSize : 1;
+
+  uv_mutex_lock(&self->poolMutex);
+  std::shared_ptr<LoginParameters> loginParams = self->loginParams;
+  uv_mutex_unlock(&self->poolMutex);
+
+  for (unsigned int i = 0; i < count; i++) {
+    RFC_CONNECTION_HANDLE connectionHandle = RfcOpenConnection(loginParams->params, loginParams->size, &self->errorInfo);
+    if (connectionHandle == nullptr) {
+      // Don't leave a half open pool behind, the connections opened so far are idle
+      self->CloseConnections();
+      break;
+    }
+
+    uv_mutex_lock(&self->poolMutex);
+    self->size++;
+    self->idleConnections.push_back(IdleConnection(connectionHandle, Now()));
+    uv_mutex_unlock(&self->poolMutex);
+  }
+}
+
+void ConnectionPool::EIO_AfterOpen(uv_work_t *req)
+{
+  ConnectionPool *self = static_cast<ConnectionPool*>(req->data);
+  napi_env env = self->env;
+  HandleScope scope(env);
+
+  napi_value argv[1];
+  argv[0] = Null(env);
+
+  if (self->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, self->errorInfo);
+    uv_timer_stop(self->reapTimer);
+  }
+
+  // Cleared first, so that the callback may open the pool again
+  Completion *completion = self->openCompletion;
+  self->openCompletion = nullptr;
+
+  completion->Complete(1, argv);
+  delete completion;
+
+  // Tasks queued while the pool was closed fail now if it could not be opened
+  self->DispatchNext();
+  self->Unref();
+
+  delete req;
+}
+
+NAPI_METHOD(ConnectionPool::Close)
+{
+  CallbackInfo info(env, cbinfo);
+  ConnectionPool *self = ObjectWrap::Unwrap<ConnectionPool>(env, info.This());
+
+  self->CloseConnections();
+  // Queued tasks fail right away instead of waiting for a connection
+  self->DispatchNext();
+
+  if (self->reapTimer != nullptr) {
+    uv_timer_stop(self->reapTimer);
+  }
+
+  return Boolean(env, true);
+}
+
+/**
+ *
+ * @return Function
+ */
+NAPI_METHOD(ConnectionPool::Lookup)
+{
+  CallbackInfo info(env, cbinfo);
+  RFC_ERROR_INFO errorInfo;
+
+  ConnectionPool *self = ObjectWrap::Unwrap<ConnectionPool>(env, info.This());
+
+  if (info.Length() != 1) {
+    return ThrowError(env, "Function expects 1 argument");
+  }
+  if (!IsString(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be function module name");
+  }
+
+  // Opening a connection or waiting for one would block the event loop
+  RFC_CONNECTION_HANDLE connectionHandle = self->TryAcquire(&errorInfo);
+  if (connectionHandle == nullptr) {
+    return Throw(env, RfcError(env, errorInfo));
+  }
+
+  napi_value f = Function::NewInstance(*self, connectionHandle, info[0]);
+  self->Release(connectionHandle);
+
+  return f;
+}
+
+/**
+ * LookupAsync(functionModuleName, [callback(errorObject, functionObject)]), returns a promise without a callback
+ */
+NAPI_METHOD(ConnectionPool::LookupAsync)
+{
+  CallbackInfo info(env, cbinfo);
+  ConnectionPool *self = ObjectWrap::Unwrap<ConnectionPool>(env, info.This());
+
+  if (info.Length() < 1 || info.Length() > 2) {
+    return ThrowError(env, "Function expects 1 or 2 arguments");
+  }
+  if (!IsString(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be function module name");
+  }
+
+  // Without a callback, a promise of the Function object is returned
+  if (info.Length() < 2 || IsUndefined(env, info[1])) {
+    Completion *completion = new Completion(env);
+    napi_value promise = completion->GetPromise();
+    Function::LookupAsync(nullptr, self, info[0], completion);
+    return promise;
+  }
+  if (!IsFunction(env, info[1])) {
+    return ThrowError(env, "Argument 2 must be a function");
+  }
+
+  Function::LookupAsync(nullptr, self, info[0], new Completion(env, info[1]));
+  return nullptr;
+}
+
+/**
+ *
+ * @return Object
+ */
+NAPI_METHOD(ConnectionPool::Stats)
+{
+  CallbackInfo info(env, cbinfo);
+  ConnectionPool *self = ObjectWrap::Unwrap<ConnectionPool>(env, info.This());
+  unsigned int size, idle;
+  unsigned int waiting = self->waiting.size();
+
+  uv_mutex_lock(&self->poolMutex);
+  size = self->size;
+  idle = self->idleConnections.size();
+  uv_mutex_unlock(&self->poolMutex);
+
+  napi_value stats = NewObject(env);
+  Set(env, stats, "size", Uint32(env, size));
+  Set(env, stats, "idle", Uint32(env, idle));
+  Set(env, stats, "busy", Uint32(env, size - idle));
+  Set(env, stats, "waiting", Uint32(env, waiting));
+  Set(env, stats, "min", Uint32(env, self->minSize));
+  Set(env, stats, "max", Uint32(env, self->maxSize));
+
+  return stats;
+}
+
+void ConnectionPool::Enqueue(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork)
+{
+  // Released once the task has completed
+  this->Ref();
+  this->waiting.push_back(new QueuedTask(this, req, work, afterWork));
+
+  this->DispatchNext();
+}
+
+/**
+ * The after work callback of a cancelled task runs with UV_ECANCELED on the next turn of the loop
+ */
+bool ConnectionPool::Cancel(uv_work_t *req)
+{
+  for (std::deque<QueuedTask*>::iterator it = this->waiting.begin(); it != this->waiting.end(); ++it) {
+    QueuedTask *task = *it;
+    if (task->req == req) {
+      this->waiting.erase(it);
+      WorkerPool::Complete(task->req, task->afterWork, UV_ECANCELED);
+      delete task;
+
+      // The task never uses the pool now
+      this->Unref();
+      return true;
+    }
+  }
+
+  // Handed to the worker threads, but maybe not started yet
+  for (std::vector<QueuedTask*>::iterator it = this->running.begin(); it != this->running.end(); ++it) {
+    if ((*it)->req == req) {
+      return WorkerPool::Cancel(&(*it)->worker);
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Hands the oldest tasks to the worker threads while the pool has room for their connections.
+ * Once the pool is closed, all of them run and fail right away.
+ */
+void ConnectionPool::DispatchNext(void)
+{
+  uv_mutex_lock(&this->poolMutex);
+  bool closed = this->closed;
+  uv_mutex_unlock(&this->poolMutex);
+
+  while (!this->waiting.empty() && (closed || this->running.size() < this->maxSize)) {
+    QueuedTask *task = this->waiting.front();
+    this->waiting.pop_front();
+    this->running.push_back(task);
+
+    WorkerPool::Queue(&task->worker, EIO_RunTask, EIO_AfterRunTask);
+  }
+}
+
+void ConnectionPool::EIO_RunTask(uv_work_t *req)
+{
+  QueuedTask *task = static_cast<QueuedTask*>(req->data);
+
+  task->work(task->req);
+}
+
+void ConnectionPool::EIO_AfterRunTask(uv_work_t *req, int status)
+{
+  QueuedTask *task = static_cast<QueuedTask*>(req->data);
+  ConnectionPool *self = task->pool;
+
+  for (std::vector<QueuedTask*>::iterator it = self->running.begin(); it != self->running.end(); ++it) {
+    if (*it == task) {
+      self->running.erase(it);
+      break;
+    }
+  }
+
+  // Start the next task first, so that it runs while JavaScript handles the result of this one
+  self->DispatchNext();
+
+  task->afterWork(task->req, status);
+  delete task;
+  self->Unref();
+}
+
+RFC_CONNECTION_HANDLE ConnectionPool::Acquire(RFC_ERROR_INFO *errorInfo)
+{
+  std::vector<RFC_CONNECTION_HANDLE> expired;
+  RFC_ERROR_INFO checkErrorInfo;
+
+  for (;;) {
+    RFC_CONNECTION_HANDLE connectionHandle = nullptr;
+    std::shared_ptr<LoginParameters> loginParams;
+    uint64_t idleSince = 0;
+    uint64_t now;
+
+    uv_mutex_lock(&this->poolMutex);
+
+    if (this->closed) {
+      uv_mutex_unlock(&this->poolMutex);
+      CloseConnectionHandles(expired);
+      SetPoolClosedError(errorInfo);
+      return nullptr;
+    }
+
+    now = Now();
+    this->ReapIdleConnections(now, expired);
+
+    if (!this->idleConnections.empty()) {
+      // Hand out the most recently used connection, so surplus ones can expire
+      connectionHandle = this->idleConnections.back().handle;
+      idleSince = this->idleConnections.back().since;
+      this->idleConnections.pop_back();
+    } else {
+      // The queue runs no more tasks than the pool may hold connections, so there is room for one
+      this->size++;
+      loginParams = this->loginParams;
+    }
+
+    uv_mutex_unlock(&this->poolMutex);
+
+    CloseConnectionHandles(expired);
+
+    if (connectionHandle == nullptr) {
+      connectionHandle = RfcOpenConnection(loginParams->params, loginParams->size, errorInfo);
+      if (connectionHandle == nullptr) {
+        uv_mutex_lock(&this->poolMutex);
+        this->size--;
+        uv_mutex_unlock(&this->poolMutex);
+      }
+      return connectionHandle;
+    }
+
+    // Health check: the handle must still be valid, long idle connections must answer a ping
+    int isValid = 0;
+    RfcIsConnectionHandleValid(connectionHandle, &isValid, &checkErrorInfo);
+    if (isValid && (now - idleSince < this->healthCheckInterval || RfcPing(connectionHandle, &checkErrorInfo) == RFC_OK)) {
+      return connectionHandle;
+    }
+
+    RfcCloseConnection(connectionHandle, &checkErrorInfo);
+
+    uv_mutex_lock(&this->poolMutex);
+    this->size--;
+    uv_mutex_unlock(&this->poolMutex);
+  }
+}
+
+/**
+ * Like Acquire, but neither waits, opens a connection nor pings an idle one
+ */
+RFC_CONNECTION_HANDLE ConnectionPool::TryAcquire(RFC_ERROR_INFO *errorInfo)
+{
+  std::vector<RFC_CONNECTION_HANDLE> expired;
+  RFC_ERROR_INFO checkErrorInfo;
+
+  for (;;) {
+    RFC_CONNECTION_HANDLE connectionHandle = nullptr;
+
+    uv_mutex_lock(&this->poolMutex);
+
+    if (this->closed) {
+      uv_mutex_unlock(&this->poolMutex);
+      CloseConnectionHandles(expired);
+      SetPoolClosedError(errorInfo);
+      return nullptr;
+    }
+
+    this->ReapIdleConnections(Now(), expired);
+
+    // Every running task may still need a connection
+    if (!this->idleConnections.empty() && this->running.size() < this->maxSize) {
+      connectionHandle = this->idleConnections.back().handle;
+      this->idleConnections.pop_back();
+    }
+
+    uv_mutex_unlock(&this->poolMutex);
+
+    CloseConnectionHandles(expired);
+
+    if (connectionHandle == nullptr) {
+      SetNoIdleConnectionError(errorInfo);
+      return nullptr;
+    }
+
+    // Only the local check, a broken connection fails the lookup itself
+    int isValid = 0;
+    RfcIsConnectionHandleValid(connectionHandle, &isValid, &checkErrorInfo);
+    if (isValid) {
+      return connectionHandle;
+    }
+
+    RfcCloseConnection(connectionHandle, &checkErrorInfo);
+
+    uv_mutex_lock(&this->poolMutex);
+    this->size--;
+    uv_mutex_unlock(&this->poolMutex);
+  }
+}
+
+void ConnectionPool::Release(RFC_CONNECTION_HANDLE connectionHandle)
+{
+  std::vector<RFC_CONNECTION_HANDLE> expired;
+  RFC_ERROR_INFO errorInfo;
+  int isValid = 0;
+
+  RfcIsConnectionHandleValid(connectionHandle, &isValid, &errorInfo);
+
+  uv_mutex_lock(&this->poolMutex);
+
+  uint64_t now = Now();
+  if (this->closed || !isValid) {
+    this->size--;
+    expired.push_back(connectionHandle);
+  } else {
+    this->idleConnections.push_back(IdleConnection(connectionHandle, now));
+    this->ReapIdleConnections(now, expired);
+  }
+
+  uv_mutex_unlock(&this->poolMutex);
+
+  CloseConnectionHandles(expired);
+}
+
+void ConnectionPool::CloseConnections(void)
+{
+  std::vector<RFC_CONNECTION_HANDLE> connectionHandles;
+
+  uv_mutex_lock(&this->poolMutex);
+
+  this->closed = true;
+  for (std::deque<IdleConnection>::iterator it = this->idleConnections.begin(); it != this->idleConnections.end(); ++it) {
+    connectionHandles.push_back(it->handle);
+  }
+  this->size -= this->idleConnections.size();
+  this->idleConnections.clear();
+
+  // Busy connections are closed as soon as they are released
+
+  uv_mutex_unlock(&this->poolMutex);
+
+  CloseConnectionHandles(connectionHandles);
+}
+
+// Must be called with poolMutex held
+void ConnectionPool::ReapIdleConnections(uint64_t now, std::vector<RFC_CONNECTION_HANDLE> &expired)
+{
+  if (this->idleTimeout == 0) {
+    return;
+  }
+
+  while (!this->idleConnections.empty() && this->size > this->minSize &&
+         now - this->idleConnections.front().since >= this->idleTimeout) {
+    expired.push_back(this->idleConnections.front().handle);
+    this->idleConnections.pop_front();
+    this->size--;
+  }
+}
+
+void ConnectionPool::OnReapTimer(uv_timer_t *handle)
+{
+  ConnectionPool *self = static_cast<ConnectionPool*>(handle->data);
+  std::vector<RFC_CONNECTION_HANDLE> expired;
+
+  uv_mutex_lock(&self->poolMutex);
+  if (!self->closed) {
+    self->ReapIdleConnections(Now(), expired);
+  }
+  uv_mutex_unlock(&self->poolMutex);
+
+  CloseConnectionHandles(expired);
+}
+
+void ConnectionPool::OnReapTimerClose(uv_handle_t *handle)
+{
+  delete reinterpret_cast<uv_timer_t*>(handle);
+}
+
+uint64_t ConnectionPool::Now(void)
+{
+  // Milliseconds
+  return uv_hrtime() / 1000000;
+}
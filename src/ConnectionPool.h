@@ -0,0 +1,154 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef CONNECTIONPOOL_H_
+#define CONNECTIONPOOL_H_
+
+#include "Common.h"
+#include "Completion.h"
+#include "ObjectWrap.h"
+#include <uv.h>
+#include <sapnwrfc.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/**
+ * Keeps a set of RFC connections to the same system and hands out one
+ * connection handle per invocation, so that invocations of functions looked
+ * up via the pool run in parallel on the worker threads.
+ */
+class ConnectionPool : public ObjectWrap
+{
+  friend class Cancellation;
+  friend class Function;
+
+  public:
+
+    static void Init(napi_env env, napi_value exports);
+
+  protected:
+
+    ConnectionPool();
+    ~ConnectionPool();
+    static NAPI_METHOD(New);
+    static NAPI_METHOD(Open);
+    static NAPI_METHOD(Close);
+    static NAPI_METHOD(Lookup);
+    static NAPI_METHOD(LookupAsync);
+    static NAPI_METHOD(Stats);
+
+    static void EIO_Open(uv_work_t *req);
+    static void EIO_AfterOpen(uv_work_t *req);
+
+    // Main thread only, runs the work once the pool has a connection for it, in the order queued
+    void Enqueue(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork);
+    // Main thread only, takes a task out of the queue before it has started
+    bool Cancel(uv_work_t *req);
+    void DispatchNext(void);
+    static void EIO_RunTask(uv_work_t *req);
+    static void EIO_AfterRunTask(uv_work_t *req, int status);
+
+    // Thread safe, only called by queued tasks, so a connection is idle or may be opened
+    RFC_CONNECTION_HANDLE Acquire(RFC_ERROR_INFO *errorInfo);
+    // Main thread only, only hands out an idle connection and never blocks
+    RFC_CONNECTION_HANDLE TryAcquire(RFC_ERROR_INFO *errorInfo);
+    void Release(RFC_CONNECTION_HANDLE connectionHandle);
+
+    void CloseConnections(void);
+    void ReapIdleConnections(uint64_t now, std::vector<RFC_CONNECTION_HANDLE> &expired);
+    static uint64_t Now(void);
+
+    static void OnReapTimer(uv_timer_t *handle);
+    static void OnReapTimerClose(uv_handle_t *handle);
+
+    class IdleConnection
+    {
+      public:
+      IdleConnection(RFC_CONNECTION_HANDLE handle, uint64_t since) : handle(handle), since(since) { };
+
+      RFC_CONNECTION_HANDLE handle;
+      uint64_t since;
+    };
+
+    /**
+     * Work waiting for a connection, or running with one on the worker threads
+     */
+    class QueuedTask
+    {
+      public:
+      QueuedTask(ConnectionPool *pool, uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork) :
+        pool(pool), req(req), work(work), afterWork(afterWork) {
+        this->worker.data = this;
+      };
+
+      ConnectionPool *pool;
+      uv_work_t worker;
+      uv_work_t *req;
+      uv_work_cb work;
+      uv_after_work_cb afterWork;
+    };
+
+    /**
+     * Login parameters of one Open, still used by connections being opened
+     * on worker threads after the pool has been closed or opened again
+     */
+    class LoginParameters
+    {
+      public:
+      LoginParameters(napi_env env, napi_value params) {
+        this->params = convertToConnectionParameters(env, params, &this->size);
+      };
+      ~LoginParameters() {
+        freeConnectionParameters(this->params, this->size);
+      };
+
+      RFC_CONNECTION_PARAMETER *params;
+      unsigned int size;
+    };
+
+    RFC_ERROR_INFO errorInfo;
+    Completion *openCompletion;
+    // Closes idle connections while the pool is open, created by the first Open
+    uv_timer_t *reapTimer;
+
+    unsigned int minSize;
+    unsigned int maxSize;
+    uint64_t idleTimeout;
+    uint64_t healthCheckInterval;
+
+    // Main thread only, at most maxSize tasks run at a time while the pool is open
+    std::deque<QueuedTask*> waiting;
+    std::vector<QueuedTask*> running;
+
+    // Guarded by poolMutex
+    std::shared_ptr<LoginParameters> loginParams;
+    std::deque<IdleConnection> idleConnections;
+    unsigned int size;
+    bool closed;
+
+    uv_mutex_t poolMutex;
+};
+
+#endif /* CONNECTIONPOOL_H_ */
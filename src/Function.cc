@@ -23,1179 +23,1454 @@ SOFTWARE.
 */
 
 #include "Function.h"
+#include "AddonState.h"
+#include "MetadataCache.h"
 #include <cassert>
 #include <sstream>
 #include <limits.h>
+#include <math.h>
 
-Nan::Persistent<v8::Function> Function::ctor;
-
-Function::Function(): connection(nullptr), functionDescHandle(nullptr)
+Function::Function(): connection(nullptr), pool(nullptr), functionDescHandle(nullptr), plan(nullptr)
 {
 }
 
 Function::~Function()
 {
+  RFC_ERROR_INFO errorInfo;
+
+  for (unsigned int i = 0; i < this->idleHandles.size(); i++) {
+    RfcDestroyFunction(this->idleHandles[i], &errorInfo);
+  }
+  delete this->plan;
+
+  if (this->functionDescHandle) {
+    MetadataCache::Release(this->functionDescHandle);
+  }
+
+  if (this->connection) {
+    this->connection->Unref();
+  }
+  if (this->pool) {
+    this->pool->Unref();
+  }
 }
 
-NAN_MODULE_INIT(Function::Init)
+/**
+ * Hands out an idle function handle, or creates a new one
+ */
+RFC_FUNCTION_HANDLE Function::AcquireHandle(RFC_ERROR_INFO *errorInfo)
 {
-  Nan::HandleScope scope;
-  v8::Local<v8::FunctionTemplate> ctorTemplate = Nan::New<v8::FunctionTemplate>(New);
-  ctorTemplate->InstanceTemplate()->SetInternalFieldCount(1);
-  ctorTemplate->SetClassName(Nan::New("Function").ToLocalChecked());
-  Nan::SetPrototypeMethod(ctorTemplate, "Invoke", Invoke);
-  Nan::SetPrototypeMethod(ctorTemplate, "MetaData", MetaData);
-
-  ctor.Reset(ctorTemplate->GetFunction());
+  if (!this->idleHandles.empty()) {
+    RFC_FUNCTION_HANDLE functionHandle = this->idleHandles.back();
+    this->idleHandles.pop_back();
+    return functionHandle;
+  }
+
+  return RfcCreateFunction(this->functionDescHandle, errorInfo);
 }
 
-v8::Local<v8::Value> Function::NewInstance(Connection &connection, const Nan::NAN_METHOD_ARGS_TYPE args)
+void Function::ReleaseHandle(RFC_FUNCTION_HANDLE functionHandle)
 {
-  Nan::EscapableHandleScope scope;
-  unsigned int parmCount;
-  RFC_RC rc = RFC_OK;
   RFC_ERROR_INFO errorInfo;
 
-  v8::Local<v8::Object> func = Nan::New(ctor)->NewInstance();
-  Function *self = node::ObjectWrap::Unwrap<Function>(func);
+  if (this->idleHandles.size() < MAX_IDLE_FUNCTION_HANDLES) {
+    this->idleHandles.push_back(functionHandle);
+  } else {
+    RfcDestroyFunction(functionHandle, &errorInfo);
+  }
+}
 
-  // Save connection
-  assert(self != nullptr);
-  self->connection = &connection;
+void Function::Init(napi_env env, napi_value exports)
+{
+  napi_property_descriptor methods[] = {
+    Method("Invoke", Invoke),
+    Method("InvokeAsync", InvokeAsync),
+    Method("InvokeBatch", InvokeBatch),
+    Method("MetaData", MetaData)
+  };
+
+  napi_value ctor;
+  napi_define_class(env, "Function", NAPI_AUTO_LENGTH, New, nullptr,
+                    sizeof(methods) / sizeof(methods[0]), methods, &ctor);
+
+  napi_create_reference(env, ctor, 1, &AddonState::Current()->functionCtor);
+  Set(env, exports, "Function", ctor);
+}
 
-  // Lookup function interface
-  v8::String::Value functionName(args[0]);
-  self->functionDescHandle = RfcGetFunctionDesc(connection.GetConnectionHandle(), (const SAP_UC*)*functionName, &errorInfo);
-#ifndef NDEBUG
-  if (errorInfo.code == RFC_INVALID_HANDLE) {
-    assert(0);
+napi_value Function::NewInstance(Connection &connection, napi_value functionName)
+{
+  napi_env env = connection.env;
+  RFC_ERROR_INFO errorInfo;
+  Description description;
+
+  SAP_UC *name = convertToSAPUC(env, functionName);
+  bool fetched = description.Fetch(connection.GetConnectionHandle(), name, &errorInfo);
+  free(name);
+  if (!fetched) {
+    RETURN_RFC_ERROR(errorInfo);
   }
-#endif
 
-  if (self->functionDescHandle == nullptr) {
-    return scope.Escape(RfcError(errorInfo));
+  return NewInstance(env, &connection, nullptr, description);
+}
+
+napi_value Function::NewInstance(ConnectionPool &pool, RFC_CONNECTION_HANDLE connectionHandle, napi_value functionName)
+{
+  napi_env env = pool.env;
+  RFC_ERROR_INFO errorInfo;
+  Description description;
+
+  SAP_UC *name = convertToSAPUC(env, functionName);
+  bool fetched = description.Fetch(connectionHandle, name, &errorInfo);
+  free(name);
+  if (!fetched) {
+    RETURN_RFC_ERROR(errorInfo);
   }
 
-  rc = RfcGetParameterCount(self->functionDescHandle, &parmCount, &errorInfo);
-  if (rc != RFC_OK) {
-    return scope.Escape(RfcError(errorInfo));
+  return NewInstance(env, nullptr, &pool, description);
+}
+
+napi_value Function::NewInstance(napi_env env, Connection *connection, ConnectionPool *pool, Description &description)
+{
+  EscapableHandleScope scope(env);
+
+  napi_value func;
+  napi_new_instance(env, Reference(env, AddonState::Current()->functionCtor), 0, nullptr, &func);
+  Function *self = ObjectWrap::Unwrap<Function>(env, func);
+  assert(self != nullptr);
+
+  // Save connection, or pool which hands out connections per invocation, both stay alive with the function
+  self->connection = connection;
+  self->pool = pool;
+  if (connection != nullptr) {
+    connection->Ref();
+  }
+  if (pool != nullptr) {
+    pool->Ref();
   }
+  self->functionDescHandle = description.functionDescHandle;
+  self->plan = description.plan;
+  description.functionDescHandle = nullptr;
+  description.plan = nullptr;
 
   // Dynamically add parameters to JS object
-  for (unsigned int i = 0; i < parmCount; i++) {
-    RFC_PARAMETER_DESC parmDesc;
-
-    rc = RfcGetParameterDescByIndex(self->functionDescHandle, i, &parmDesc, &errorInfo);
-    if (rc != RFC_OK) {
-      return scope.Escape(RfcError(errorInfo));
-    }
-    func->Set(Nan::New((const uint16_t*)(parmDesc.name)).ToLocalChecked(), Nan::Null());
+  for (unsigned int i = 0; i < self->plan->parameters.size(); i++) {
+    Set(env, func, self->plan->names.Get(env, i), Null(env));
   }
 
   return scope.Escape(func);
 }
 
-NAN_METHOD(Function::New)
+/**
+ * Fetches the function interface, does not touch V8 and may run on a worker thread
+ */
+bool Function::Description::Fetch(RFC_CONNECTION_HANDLE connectionHandle, const SAP_UC *functionName, RFC_ERROR_INFO *errorInfo)
 {
-  if (!info.IsConstructCall()) {
-    Nan::ThrowError("Invalid call format. Please use the 'new' operator.");
-    return;
+  // Lookup function interface
+  this->functionDescHandle = MetadataCache::GetFunctionDesc(connectionHandle, functionName, errorInfo);
+#ifndef NDEBUG
+  if (errorInfo->code == RFC_INVALID_HANDLE) {
+    assert(0);
   }
+#endif
 
-  Function *self = new Function();
-  self->Wrap(info.This());
+  if (this->functionDescHandle == nullptr) {
+    return false;
+  }
 
-  info.GetReturnValue().Set(info.This());
-}
+  this->plan = new FunctionPlan();
+  if (!this->plan->Compile(this->functionDescHandle, errorInfo)) {
+    delete this->plan;
+    this->plan = nullptr;
+    MetadataCache::Release(this->functionDescHandle);
+    this->functionDescHandle = nullptr;
+    return false;
+  }
 
+  return true;
+}
 
-NAN_METHOD(Function::Invoke)
+/**
+ * Queues a lookup on the worker threads
+ */
+void Function::LookupAsync(Connection *connection, ConnectionPool *pool, napi_value functionName, Completion *completion)
 {
-  RFC_RC rc = RFC_OK;
-  unsigned int parmCount;
-  RFC_ERROR_INFO errorInfo;
-
-  Function *self = node::ObjectWrap::Unwrap<Function>(info.This());
-  assert(self != nullptr);
+  LookupBaton *baton = new LookupBaton();
+  memset(&baton->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  baton->functionName = convertToSAPUC(completion->env, functionName);
+  baton->completion = completion;
 
-  if (info.Length() < 1) {
-    Nan::ThrowError("Function expects 2 arguments");
-    return;
+  baton->connection = connection;
+  baton->pool = pool;
+  if (connection != nullptr) {
+    connection->Ref();
   }
-  if (!info[0]->IsObject()) {
-    Nan::ThrowError("Argument 1 must be an object");
-    return;
-  }
-  if (!info[1]->IsFunction()) {
-    Nan::ThrowError("Argument 2 must be a function");
-    return;
+  if (pool != nullptr) {
+    pool->Ref();
   }
 
-  // Create baton to hold call context
-  InvocationBaton *baton = new InvocationBaton();
-  baton->function = self;
-  baton->connection = self->connection;
+  uv_work_t* req = new uv_work_t();
+  req->data = baton;
+  if (connection != nullptr) {
+    connection->Enqueue(req, EIO_Lookup, (uv_after_work_cb)EIO_AfterLookup);
+  } else {
+    pool->Enqueue(req, EIO_Lookup, (uv_after_work_cb)EIO_AfterLookup);
+  }
+}
 
-  // Store callback
-  baton->cbInvoke = new Nan::Callback(info[1].As<v8::Function>());
+void Function::EIO_Lookup(uv_work_t *req)
+{
+  LookupBaton *baton = static_cast<LookupBaton*>(req->data);
+  RFC_CONNECTION_HANDLE connectionHandle;
 
-  baton->functionHandle = RfcCreateFunction(self->functionDescHandle, &errorInfo);
-  if (baton->functionHandle == nullptr) {
-    delete baton;
-    RETURN_RFC_ERROR(errorInfo);
+  if (baton->pool != nullptr) {
+    connectionHandle = baton->pool->Acquire(&baton->errorInfo);
+    if (connectionHandle == nullptr) {
+      return;
+    }
+  } else {
+    baton->connection->LockMutex();
+    connectionHandle = baton->connection->GetConnectionHandle();
   }
 
-  rc = RfcGetParameterCount(self->functionDescHandle, &parmCount, &errorInfo);
-  if (rc != RFC_OK) {
-    delete baton;
-    RETURN_RFC_ERROR(errorInfo);
+  baton->description.Fetch(connectionHandle, baton->functionName, &baton->errorInfo);
+
+  if (baton->pool != nullptr) {
+    baton->pool->Release(connectionHandle);
+  } else {
+    baton->connection->UnlockMutex();
   }
+}
 
-  v8::Local<v8::Object> inputParm = info[0]->ToObject();
+void Function::EIO_AfterLookup(uv_work_t *req)
+{
+  LookupBaton *baton = static_cast<LookupBaton*>(req->data);
+  napi_env env = baton->completion->env;
+  HandleScope scope(env);
 
-  for (unsigned int i = 0; i < parmCount; i++) {
-    RFC_PARAMETER_DESC parmDesc;
+  napi_value argv[2];
+  argv[0] = Null(env);
+  argv[1] = Null(env);
 
-    rc = RfcGetParameterDescByIndex(self->functionDescHandle, i, &parmDesc, &errorInfo);
-    if (rc != RFC_OK) {
-      delete baton;
-      RETURN_RFC_ERROR(errorInfo);
-    }
+  if (baton->description.functionDescHandle == nullptr || baton->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, baton->errorInfo);
+  } else {
+    argv[1] = NewInstance(env, baton->connection, baton->pool, baton->description);
+  }
 
-    v8::Local<v8::String> parmName = Nan::New((const uint16_t*)(parmDesc.name)).ToLocalChecked();
-    v8::Local<v8::Value> result = Nan::Undefined();
+  baton->completion->Complete(2, argv);
 
-    if (inputParm->Has(parmName) && !inputParm->Get(parmName)->IsNull()) {
-      switch (parmDesc.direction) {
-        case RFC_IMPORT:
-        case RFC_CHANGING:
-        case RFC_TABLES:
-          result = self->SetValue(baton->functionHandle, parmDesc.type, parmDesc.name, parmDesc.nucLength, inputParm->Get(parmName));
-          break;
-        case RFC_EXPORT:
-        default:
-          break;
-      }
-
-      if (IsException(result)) {
-        v8::Local<v8::Value> argv[2];
-        argv[0] = result;
-        argv[1] = Nan::Null();
-        Nan::TryCatch try_catch;
+  delete baton;
+  delete req;
+}
 
-        baton->cbInvoke->Call(Nan::GetCurrentContext()->Global(), 2, argv);
-        delete baton;
-        if (try_catch.HasCaught()) {
-          Nan::FatalException(try_catch);
-        }
-        info.GetReturnValue().SetUndefined();
-        return;
-      }
-    }
+NAPI_METHOD(Function::New)
+{
+  CallbackInfo info(env, cbinfo);
 
-    rc = RfcSetParameterActive(baton->functionHandle, parmDesc.name, true, &errorInfo);
-    if (rc != RFC_OK) {
-      delete baton;
-      RETURN_RFC_ERROR(errorInfo);
-    }
+  if (!info.IsConstructCall()) {
+    return ThrowError(env, "Invalid call format. Please use the 'new' operator.");
   }
 
-  self->Ref();
-  uv_work_t* req = new uv_work_t();
-  req->data = baton;
-  uv_queue_work(uv_default_loop(), req, EIO_Invoke, (uv_after_work_cb)EIO_AfterInvoke);
-#if !NODE_VERSION_AT_LEAST(0, 7, 9)
-  uv_ref(uv_default_loop());
-#endif
+  Function *self = new Function();
+  self->Wrap(env, info.This());
 
-  info.GetReturnValue().SetUndefined();
+  return info.This();
 }
 
-NAN_METHOD(Function::MetaData)
-{
-  RFC_RC rc = RFC_OK;
-  unsigned int parmCount;
-  RFC_ERROR_INFO errorInfo;
 
-  Function *self = node::ObjectWrap::Unwrap<Function>(info.This());
+NAPI_METHOD(Function::Invoke)
+{
+  CallbackInfo info(env, cbinfo);
+  Function *self = ObjectWrap::Unwrap<Function>(env, info.This());
   assert(self != nullptr);
 
-  rc = RfcGetParameterCount(self->functionDescHandle, &parmCount, &errorInfo);
-  if (rc != RFC_OK) {
-    RETURN_RFC_ERROR(errorInfo);
+  if (info.Length() < 1) {
+    return ThrowError(env, "Function expects 2 arguments");
+  }
+  if (!IsObject(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an object");
   }
 
-  v8::Local<v8::Object> metaObject = Nan::New<v8::Object>();
-  RFC_ABAP_NAME functionName;
-  rc = RfcGetFunctionName(self->functionDescHandle, functionName, &errorInfo);
-  if (rc != RFC_OK) {
-    RETURN_RFC_ERROR(errorInfo);
+  // Options are optional
+  int cbIndex = info.Length() > 2 ? 2 : 1;
+  if (!IsFunction(env, info[cbIndex])) {
+    return ThrowError(env, cbIndex == 2 ? "Argument 3 must be a function" : "Argument 2 must be a function");
   }
 
-  RFC_FUNCTION_HANDLE functionHandle = RfcCreateFunction(self->functionDescHandle, &errorInfo);
-  if (functionHandle == nullptr) {
-    RfcDestroyFunction(functionHandle, &errorInfo);
-    RETURN_RFC_ERROR(errorInfo);
+  InvocationOptions options;
+  napi_value signal = nullptr;
+  if (cbIndex == 2 && !ParseOptions(env, info[1], options, signal)) {
+    return nullptr;
   }
 
-  std::string title = "Signature of SAP RFC function " + convertToString(functionName);
+  if (self->plan == nullptr) {
+    return ThrowError(env, "Function has not been looked up");
+  }
 
-  metaObject->Set(Nan::New<v8::String>("title").ToLocalChecked(),
-    Nan::New<v8::String>(title.c_str()).ToLocalChecked());
-  metaObject->Set(Nan::New<v8::String>("type").ToLocalChecked(),
-    Nan::New<v8::String>("object").ToLocalChecked());
+  self->QueueInvoke(info[0], options, signal, new Completion(env, info[cbIndex]));
 
-  v8::Local<v8::Object> properties = Nan::New<v8::Object>();
-  metaObject->Set(Nan::New<v8::String>("properties").ToLocalChecked(), properties);
+  return nullptr;
+}
 
-  // Dynamically add parameters to JS object
-  for (unsigned int i = 0; i < parmCount; i++) {
-    RFC_PARAMETER_DESC parmDesc;
+/**
+ * InvokeAsync(functionParameters, [options]) returns a promise of the result
+ */
+NAPI_METHOD(Function::InvokeAsync)
+{
+  CallbackInfo info(env, cbinfo);
+  Function *self = ObjectWrap::Unwrap<Function>(env, info.This());
+  assert(self != nullptr);
 
-    rc = RfcGetParameterDescByIndex(self->functionDescHandle, i, &parmDesc, &errorInfo);
-    if (rc != RFC_OK) {
-      RETURN_RFC_ERROR(errorInfo);
-    }
+  if (info.Length() < 1) {
+    return ThrowError(env, "Function expects 1 argument");
+  }
+  if (!IsObject(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an object");
+  }
 
-    if (!addMetaData(functionHandle, properties, parmDesc.name, parmDesc.type,
-                parmDesc.nucLength, parmDesc.direction, &errorInfo, parmDesc.parameterText)) {
-      RETURN_RFC_ERROR(errorInfo);
-    }
+  InvocationOptions options;
+  napi_value signal = nullptr;
+  if (info.Length() > 1 && !ParseOptions(env, info[1], options, signal)) {
+    return nullptr;
   }
 
-  RfcDestroyFunction(functionHandle, &errorInfo);
+  if (self->plan == nullptr) {
+    return ThrowError(env, "Function has not been looked up");
+  }
 
-  info.GetReturnValue().Set(metaObject);
+  Completion *completion = new Completion(env);
+  napi_value promise = completion->GetPromise();
+  self->QueueInvoke(info[0], options, signal, completion);
+
+  return promise;
 }
 
-void Function::EIO_Invoke(uv_work_t *req)
+/**
+ * Snapshots the input and queues the invocation, takes over the completion
+ */
+void Function::QueueInvoke(napi_value params, const InvocationOptions &options, napi_value signal, Completion *completion)
 {
-  RFC_RC rc = RFC_OK;
-  int isValid;
-
-  InvocationBaton *baton = static_cast<InvocationBaton*>(req->data);
+  RFC_ERROR_INFO errorInfo;
 
-  assert(baton != nullptr);
-  assert(baton->functionHandle != nullptr);
+  // Create baton to hold call context
+  InvocationBaton *baton = new InvocationBaton();
+  baton->connection = this->connection;
+  baton->pool = this->pool;
+  if (baton->connection != nullptr) {
+    baton->connection->Ref();
+  }
+  if (baton->pool != nullptr) {
+    baton->pool->Ref();
+  }
+  baton->options = options;
+  baton->completion = completion;
 
-  baton->connection->LockMutex();
+  baton->functionHandle = this->AcquireHandle(&errorInfo);
+  if (baton->functionHandle == nullptr) {
+    completion->Fail(RfcError(this->env, errorInfo));
+    delete baton;
+    return;
+  }
 
-  // Invocation
-  rc = RfcInvoke(baton->connection->GetConnectionHandle(), baton->functionHandle, &baton->errorInfo);
+  napi_value result = this->SnapshotInputs(params, baton->inputs, baton->storage);
+  if (IsException(this->env, result)) {
+    completion->Fail(result);
+    delete baton;
+    return;
+  }
 
-  // If handle is invalid, fetch a better error message
-  if (baton->errorInfo.code == RFC_INVALID_HANDLE) {
-    rc = RfcIsConnectionHandleValid(baton->connection->GetConnectionHandle(), &isValid, &baton->errorInfo);
+  // The timeout starts now, so that it includes the wait in the queue
+  if (options.timeout > 0 || signal != nullptr) {
+    baton->cancellation = new Cancellation(this->env);
+    if (!baton->cancellation->Arm(options.timeout, signal)) {
+      baton->cancellation->GetError(&errorInfo);
+      completion->Fail(RfcError(this->env, errorInfo));
+      delete baton;
+      return;
+    }
   }
 
-  baton->connection->UnlockMutex();
+  // Released by the baton
+  this->Ref();
+  baton->function = this;
+
+  uv_work_t* req = new uv_work_t();
+  req->data = baton;
+  if (baton->cancellation != nullptr) {
+    baton->cancellation->Track(req, this->connection, this->pool);
+  }
+  if (this->connection != nullptr) {
+    // Pooled invocations run in parallel, those of one connection one after the other
+    this->connection->Enqueue(req, EIO_Invoke, EIO_AfterInvoke, options.priority);
+  } else {
+    this->pool->Enqueue(req, EIO_Invoke, EIO_AfterInvoke);
+  }
 }
 
-void Function::EIO_AfterInvoke(uv_work_t *req)
+NAPI_METHOD(Function::InvokeBatch)
 {
-  Nan::HandleScope scope;
+  CallbackInfo info(env, cbinfo);
   RFC_ERROR_INFO errorInfo;
 
-  InvocationBaton *baton = static_cast<InvocationBaton*>(req->data);
-  assert(baton != nullptr);
+  Function *self = ObjectWrap::Unwrap<Function>(env, info.This());
+  assert(self != nullptr);
 
-  v8::Local<v8::Value> argv[2];
-  argv[0] = Nan::Null();
-  argv[1] = Nan::Null();
+  if (info.Length() < 1) {
+    return ThrowError(env, "Function expects 2 arguments");
+  }
+  if (!IsArray(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an array");
+  }
 
-  if (baton->errorInfo.code != RFC_OK) {
-    argv[0] = RfcError(baton->errorInfo);
+  // Options are optional
+  int cbIndex = info.Length() > 2 ? 2 : 1;
+  if (!IsFunction(env, info[cbIndex])) {
+    return ThrowError(env, cbIndex == 2 ? "Argument 3 must be a function" : "Argument 2 must be a function");
   }
 
-  v8::Local<v8::Value> result = baton->function->DoReceive(baton->functionHandle);
-  if (IsException(result)) {
-    argv[0] = result;
-  } else {
-    argv[1] = result;
+  InvocationOptions options;
+  napi_value signal = nullptr;
+  if (cbIndex == 2 && !ParseOptions(env, info[1], options, signal)) {
+    return nullptr;
+  }
+  if (options.tableMode == TABLE_STREAM) {
+    return ThrowError(env, "Option tables: 'stream' is not supported by InvokeBatch");
+  }
+  if (options.timeout > 0 || signal != nullptr) {
+    return ThrowError(env, "Options timeout and signal are not supported by InvokeBatch");
   }
 
-  if (baton->functionHandle) {
-    RfcDestroyFunction(baton->functionHandle, &errorInfo);
-    baton->functionHandle = nullptr;
+  if (self->plan == nullptr) {
+    return ThrowError(env, "Function has not been looked up");
   }
 
-  Nan::TryCatch try_catch;
+  napi_value calls = info[0];
+  uint32_t callCount = ArrayLength(env, calls);
+  for (uint32_t i = 0; i < callCount; i++) {
+    if (!IsObject(env, Get(env, calls, i))) {
+      return ThrowError(env, "Argument 1 must be an array of objects");
+    }
+  }
 
-  assert(!baton->cbInvoke.IsEmpty());
-  baton->cbInvoke->Call(Nan::GetCurrentContext()->Global(), 2, argv);
+  BatchBaton *baton = new BatchBaton();
+  baton->connection = self->connection;
+  baton->pool = self->pool;
+  if (baton->connection != nullptr) {
+    baton->connection->Ref();
+  }
+  if (baton->pool != nullptr) {
+    baton->pool->Ref();
+  }
+  baton->options = options;
+  baton->completion = new Completion(env, info[cbIndex]);
 
-  delete baton;
+  baton->functionHandle = self->AcquireHandle(&errorInfo);
+  if (baton->functionHandle == nullptr) {
+    delete baton;
+    RETURN_RFC_ERROR(errorInfo);
+  }
+
+  // All calls are snapshot up front, invalid input fails the whole batch
+  baton->items.resize(callCount);
+  for (uint32_t i = 0; i < callCount; i++) {
+    napi_value result = self->SnapshotInputs(Get(env, calls, i), baton->items[i].inputs, baton->storage);
+    if (IsException(env, result)) {
+      napi_value argv[2];
+      argv[0] = result;
+      argv[1] = Null(env);
 
-  if (try_catch.HasCaught()) {
-    Nan::FatalException(try_catch);
+      baton->completion->Complete(2, argv);
+      delete baton;
+      return nullptr;
+    }
   }
+
+  // Released by the baton
+  self->Ref();
+  baton->function = self;
+
+  uv_work_t* req = new uv_work_t();
+  req->data = baton;
+  if (self->connection != nullptr) {
+    self->connection->Enqueue(req, EIO_InvokeBatch, (uv_after_work_cb)EIO_AfterInvokeBatch, options.priority);
+  } else {
+    self->pool->Enqueue(req, EIO_InvokeBatch, (uv_after_work_cb)EIO_AfterInvokeBatch);
+  }
+
+  return nullptr;
 }
 
-v8::Local<v8::Value> Function::DoReceive(const CHND container)
+/**
+ * Snapshots the input parameters of one call, they are written to the function
+ * handle on the worker thread
+ */
+napi_value Function::SnapshotInputs(napi_value value, std::vector<NativeValue> &inputs, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-  unsigned int parmCount;
+  EscapableHandleScope scope(this->env);
 
-  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  inputs.resize(this->plan->parameters.size());
 
-  // Get resulting values for exporting/changing/table parameters
-  rc = RfcGetParameterCount(this->functionDescHandle, &parmCount, &errorInfo);
-  if (rc != RFC_OK) {
-    return scope.Escape(RfcError(errorInfo));
-  }
+  for (unsigned int i = 0; i < this->plan->parameters.size(); i++) {
+    const FieldPlan &parameter = this->plan->parameters[i];
 
-  for (unsigned int i = 0; i < parmCount; i++) {
-    RFC_PARAMETER_DESC parmDesc;
-    v8::Local<v8::Value> parmValue;
+    napi_value parmName = this->plan->names.Get(this->env, i);
+    napi_value result = Undefined(this->env);
 
-    rc = RfcGetParameterDescByIndex(this->functionDescHandle, i, &parmDesc, &errorInfo);
-    if (rc != RFC_OK) {
-      return scope.Escape(RfcError(errorInfo));
+    if (!Has(this->env, value, parmName)) {
+      continue;
+    }
+    napi_value parmValue = Get(this->env, value, parmName);
+    if (IsNull(this->env, parmValue)) {
+      continue;
     }
 
-    switch (parmDesc.direction) {
+    switch (parameter.direction) {
       case RFC_IMPORT:
-        //break;
       case RFC_CHANGING:
       case RFC_TABLES:
-      case RFC_EXPORT:
-        parmValue = this->GetValue(container, parmDesc.type, parmDesc.name, parmDesc.nucLength);
-        if (IsException(parmValue)) {
-          return scope.Escape(parmValue);
-        }
-        result->Set(Nan::New<v8::String>((const uint16_t*)parmDesc.name).ToLocalChecked(), parmValue);
+        result = this->SetValue(inputs[i], parameter, parmValue, storage);
         break;
+      case RFC_EXPORT:
       default:
-        assert(0);
         break;
     }
+
+    if (IsException(this->env, result)) {
+      return scope.Escape(result);
+    }
   }
 
-  return scope.Escape(result);
+  return scope.Escape(Null(this->env));
 }
 
-v8::Local<v8::Value> Function::SetValue(const CHND container, RFCTYPE type, const SAP_UC *name, unsigned len, v8::Local<v8::Value> value)
+/**
+ * Reads the options object of Invoke, throws and returns false on invalid values
+ */
+bool Function::ParseOptions(napi_env env, napi_value value, InvocationOptions &options, napi_value &signal)
 {
-  Nan::EscapableHandleScope scope;
-
-  v8::Local<v8::Value> result = Nan::Undefined();
-
-  switch (type) {
-    case RFCTYPE_DATE:
-      result = this->DateToExternal(container, name, value);
-      break;
-    case RFCTYPE_TIME:
-      result = this->TimeToExternal(container, name, value);
-      break;
-    case RFCTYPE_NUM:
-      result = this->NumToExternal(container, name, value, len);
-      break;
-    case RFCTYPE_BCD:
-      result = this->BCDToExternal(container, name, value);
-      break;
-    case RFCTYPE_CHAR:
-      result = this->CharToExternal(container, name, value, len);
-      break;
-    case RFCTYPE_BYTE:
-      result = this->ByteToExternal(container, name, value, len);
-      break;
-    case RFCTYPE_FLOAT:
-      result = this->FloatToExternal(container, name, value);
-      break;
-    case RFCTYPE_INT:
-      result = this->IntToExternal(container, name, value);
-      break;
-    case RFCTYPE_INT1:
-      result = this->Int1ToExternal(container, name, value);
-      break;
-    case RFCTYPE_INT2:
-      result = this->Int2ToExternal(container, name, value);
-      break;
-    case RFCTYPE_STRUCTURE:
-      result = this->StructureToExternal(container, name, value);
-      break;
-    case RFCTYPE_TABLE:
-      result = this->TableToExternal(container, name, value);
-      break;
-    case RFCTYPE_STRING:
-      result = this->StringToExternal(container, name, value);
-      break;
-    case RFCTYPE_XSTRING:
-      result = this->XStringToExternal(container, name, value);
-      break;
-    default:
-      // Type not implemented
-      return scope.Escape(RfcError("RFC type not implemented: ", Nan::New<v8::Uint32>(type)->ToString()));
-      break;
+  if (IsUndefined(env, value) || IsNull(env, value)) {
+    return true;
   }
-
-  if (IsException(result)) {
-    return scope.Escape(result);
+  if (!IsObject(env, value)) {
+    ThrowError(env, "Argument 2 must be an object");
+    return false;
   }
 
-  return scope.Escape(Nan::Null());
-}
-
-v8::Local<v8::Value> Function::StructureToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-  RFC_STRUCTURE_HANDLE strucHandle;
-
-  rc = RfcGetStructure(container, name, &strucHandle, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  napi_value tables = Get(env, value, "tables");
+  if (!IsUndefined(env, tables)) {
+    std::string mode = convertToString(env, tables);
+    if (mode == "rows") {
+      options.tableMode = TABLE_ROWS;
+    } else if (mode == "stream") {
+      options.tableMode = TABLE_STREAM;
+    } else if (mode == "columns") {
+      options.tableMode = TABLE_COLUMNS;
+    } else {
+      ThrowError(env, "Option tables must be one of 'rows', 'stream', 'columns'");
+      return false;
+    }
   }
 
-  return scope.Escape(this->StructureToExternal(container, strucHandle, value));
-}
-
-v8::Local<v8::Value> Function::StructureToExternal(const CHND container, const RFC_STRUCTURE_HANDLE struc, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-  RFC_TYPE_DESC_HANDLE typeHandle;
-  RFC_FIELD_DESC fieldDesc;
-  unsigned fieldCount;
+  napi_value batchSize = Get(env, value, "batchSize");
+  if (!IsUndefined(env, batchSize)) {
+    if (!IsUint32(env, batchSize) || Uint32Value(env, batchSize) == 0) {
+      ThrowError(env, "Option batchSize must be a positive integer");
+      return false;
+    }
+    options.batchSize = Uint32Value(env, batchSize);
+  }
+
+  napi_value priority = Get(env, value, "priority");
+  if (!IsUndefined(env, priority)) {
+    std::string lane = convertToString(env, priority);
+    if (lane == "high") {
+      options.priority = Connection::PRIORITY_HIGH;
+    } else if (lane == "normal") {
+      options.priority = Connection::PRIORITY_NORMAL;
+    } else if (lane == "low") {
+      options.priority = Connection::PRIORITY_LOW;
+    } else {
+      ThrowError(env, "Option priority must be one of 'high', 'normal', 'low'");
+      return false;
+    }
+  }
 
-  if (!value->IsObject()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", fieldDesc.name);
+  napi_value timeout = Get(env, value, "timeout");
+  if (!IsUndefined(env, timeout)) {
+    if (!IsUint32(env, timeout) || Uint32Value(env, timeout) == 0) {
+      ThrowError(env, "Option timeout must be a positive integer");
+      return false;
+    }
+    options.timeout = Uint32Value(env, timeout);
   }
-  v8::Local<v8::Object> valueObj = value->ToObject();
 
-  typeHandle = RfcDescribeType(struc, &errorInfo);
-  assert(typeHandle);
-  if (typeHandle == nullptr) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  napi_value abortSignal = Get(env, value, "signal");
+  if (!IsUndefined(env, abortSignal) && !IsNull(env, abortSignal)) {
+    if (!IsObject(env, abortSignal) ||
+        !IsFunction(env, Get(env, abortSignal, "addEventListener"))) {
+      ThrowError(env, "Option signal must be an AbortSignal");
+      return false;
+    }
+    signal = abortSignal;
   }
 
-  rc = RfcGetFieldCount(typeHandle, &fieldCount, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  napi_value rtrim = Get(env, value, "rtrim");
+  if (!IsUndefined(env, rtrim)) {
+    options.decode.rtrim = BooleanValue(env, rtrim);
   }
 
-  for (unsigned int i = 0; i < fieldCount; i++) {
-    rc = RfcGetFieldDescByIndex(typeHandle, i, &fieldDesc, &errorInfo);
-    if (rc != RFC_OK) {
-      return ESCAPE_RFC_ERROR(errorInfo);
+  napi_value int8 = Get(env, value, "int8");
+  if (!IsUndefined(env, int8)) {
+    std::string mode = convertToString(env, int8);
+    if (mode == "number") {
+      options.decode.int8AsBigInt = false;
+    } else if (mode == "bigint") {
+      options.decode.int8AsBigInt = true;
+    } else {
+      ThrowError(env, "Option int8 must be one of 'number', 'bigint'");
+      return false;
     }
+  }
 
-    v8::Local<v8::String> fieldName = Nan::New<v8::String>((const uint16_t*)(fieldDesc.name)).ToLocalChecked();
+  napi_value skipEmpty = Get(env, value, "skipEmpty");
+  if (!IsUndefined(env, skipEmpty)) {
+    options.decode.skipEmpty = BooleanValue(env, skipEmpty);
+  }
 
-    if (valueObj->Has(fieldName)) {
-      v8::Local<v8::Value> result = this->SetValue(struc, fieldDesc.type, fieldDesc.name, fieldDesc.nucLength, valueObj->Get(fieldName));
-      // Bail out on exception
-      if (IsException(result)) {
-        return scope.Escape(result);
-      }
+  napi_value decimals = Get(env, value, "decimals");
+  if (!IsUndefined(env, decimals)) {
+    std::string mode = convertToString(env, decimals);
+    if (mode == "number") {
+      options.decode.decimals = DecodeOptions::DECIMALS_NUMBER;
+    } else if (mode == "string") {
+      options.decode.decimals = DecodeOptions::DECIMALS_STRING;
+    } else if (mode == "bigint") {
+      options.decode.decimals = DecodeOptions::DECIMALS_BIGINT;
+    } else {
+      ThrowError(env, "Option decimals must be one of 'number', 'string', 'bigint'");
+      return false;
     }
   }
 
-  return scope.Escape(Nan::Null());
+  return true;
 }
 
-v8::Local<v8::Value> Function::TableToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
+NAPI_METHOD(Function::MetaData)
 {
-  Nan::EscapableHandleScope scope;
+  CallbackInfo info(env, cbinfo);
   RFC_RC rc = RFC_OK;
+  unsigned int parmCount;
   RFC_ERROR_INFO errorInfo;
-  RFC_TABLE_HANDLE tableHandle;
-  RFC_STRUCTURE_HANDLE strucHandle;
-  uint32_t rowCount;
 
-  if (!value->IsArray()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
+  Function *self = ObjectWrap::Unwrap<Function>(env, info.This());
+  assert(self != nullptr);
 
-  rc = RfcGetTable(container, name, &tableHandle, &errorInfo);
+  rc = RfcGetParameterCount(self->functionDescHandle, &parmCount, &errorInfo);
   if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+    RETURN_RFC_ERROR(errorInfo);
   }
 
-  v8::Local<v8::Array> source = v8::Local<v8::Array>::Cast(value);
-  rowCount = source->Length();
-
-  for (uint32_t i = 0; i < rowCount; i++){
-    strucHandle = RfcAppendNewRow(tableHandle, nullptr);
-
-    v8::Local<v8::Value> line = this->StructureToExternal(container, strucHandle, source->Get(i));
-    // Bail out on exception
-    if (IsException(line)) {
-      return scope.Escape(line);
-    }
+  napi_value metaObject = NewObject(env);
+  RFC_ABAP_NAME functionName;
+  rc = RfcGetFunctionName(self->functionDescHandle, functionName, &errorInfo);
+  if (rc != RFC_OK) {
+    RETURN_RFC_ERROR(errorInfo);
   }
 
-  return scope.Escape(Nan::Null());
-}
-
-v8::Local<v8::Value> Function::StringToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-
-  if (!value->IsString()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
+  // Not one of the idle handles, addMetaData appends rows to the tables
+  RFC_ERROR_INFO destroyErrorInfo;
+  RFC_FUNCTION_HANDLE functionHandle = RfcCreateFunction(self->functionDescHandle, &errorInfo);
+  if (functionHandle == nullptr) {
+    RETURN_RFC_ERROR(errorInfo);
   }
 
-  v8::String::Value valueU16(value->ToString());
-  rc = RfcSetString(container, name, (const SAP_UC*)*valueU16, valueU16.length(), &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+  std::string title = "Signature of SAP RFC function " + convertToString(functionName);
 
-  return scope.Escape(Nan::Null());
-}
+  Set(env, metaObject, "title", NewString(env, title.c_str()));
+  Set(env, metaObject, "type", NewString(env, "object"));
 
-v8::Local<v8::Value> Function::XStringToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  napi_value properties = NewObject(env);
+  Set(env, metaObject, "properties", properties);
 
-  if (!node::Buffer::HasInstance(value)) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
+  // Dynamically add parameters to JS object
+  for (unsigned int i = 0; i < parmCount; i++) {
+    RFC_PARAMETER_DESC parmDesc;
 
-  unsigned int bufferLength = node::Buffer::Length(value);
-  SAP_RAW* bufferData = reinterpret_cast<SAP_RAW*>(node::Buffer::Data(value));
+    rc = RfcGetParameterDescByIndex(self->functionDescHandle, i, &parmDesc, &errorInfo);
+    if (rc != RFC_OK) {
+      RfcDestroyFunction(functionHandle, &destroyErrorInfo);
+      RETURN_RFC_ERROR(errorInfo);
+    }
 
-  rc = RfcSetXString(container, name, bufferData, bufferLength, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+    if (!addMetaData(env, functionHandle, properties, parmDesc.name, parmDesc.type,
+                parmDesc.nucLength, parmDesc.decimals, parmDesc.direction, &errorInfo, parmDesc.parameterText)) {
+      RfcDestroyFunction(functionHandle, &destroyErrorInfo);
+      RETURN_RFC_ERROR(errorInfo);
+    }
   }
 
-  return scope.Escape(Nan::Null());
+  RfcDestroyFunction(functionHandle, &destroyErrorInfo);
+
+  return metaObject;
 }
 
-v8::Local<v8::Value> Function::NumToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value, unsigned len)
+void Function::EIO_Invoke(uv_work_t *req)
 {
-  Nan::EscapableHandleScope scope;
   RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  int isValid;
 
-  if (!value->IsString()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
+  InvocationBaton *baton = static_cast<InvocationBaton*>(req->data);
+
+  assert(baton != nullptr);
+  assert(baton->functionHandle != nullptr);
 
-  v8::String::Value valueU16(value->ToString());
-  if (valueU16.length() < 0 || (static_cast<unsigned int>(valueU16.length())) > len) {
-    return ESCAPE_RFC_ERROR("Argument exceeds maximum length: ", name);
+  const FunctionPlan &plan = *baton->function->plan;
+
+  // Write the input snapshot before occupying a connection
+  if (!EncodeParameters(baton->functionHandle, plan, baton->inputs, &baton->errorInfo)) {
+    return;
   }
 
-  rc = RfcSetNum(container, name, (const RFC_NUM*)*valueU16, valueU16.length(), &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  RFC_CONNECTION_HANDLE connectionHandle;
+  if (baton->pool != nullptr) {
+    connectionHandle = baton->pool->Acquire(&baton->errorInfo);
+    if (connectionHandle == nullptr) {
+      return;
+    }
+  } else {
+    baton->connection->LockMutex();
+    connectionHandle = baton->connection->GetConnectionHandle();
   }
 
-  return scope.Escape(Nan::Null());
-}
+  // Invocation, unless it has been cancelled while it was queued
+  Cancellation *cancellation = baton->cancellation;
+  bool cancelled = cancellation != nullptr && !cancellation->Begin(connectionHandle);
+  if (!cancelled) {
+    rc = RfcInvoke(connectionHandle, baton->functionHandle, &baton->errorInfo);
+    cancelled = cancellation != nullptr && cancellation->End();
+  }
 
-v8::Local<v8::Value> Function::CharToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value, unsigned len)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  if (cancelled) {
+    // Report the timeout or abort rather than the error of the cancelled call
+    cancellation->GetError(&baton->errorInfo);
+  } else if (baton->errorInfo.code == RFC_INVALID_HANDLE) {
+    // If handle is invalid, fetch a better error message
+    RfcIsConnectionHandleValid(connectionHandle, &isValid, &baton->errorInfo);
+  }
 
-  if (!value->IsString()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
+  if (baton->pool != nullptr) {
+    baton->pool->Release(connectionHandle);
+  } else {
+    baton->connection->UnlockMutex();
   }
 
-  v8::String::Value valueU16(value->ToString());
-  if (valueU16.length() < 0 || (static_cast<unsigned int>(valueU16.length())) > len) {
-    return ESCAPE_RFC_ERROR("Argument exceeds maximum length: ", name);
+  // A failed or cancelled call has no results, only its error is reported
+  if (!cancelled && rc == RFC_OK) {
+    DecodeResults(baton->functionHandle, plan, baton->options, baton->arena, baton->results, &baton->decodeErrorInfo);
   }
 
-  rc = RfcSetChars(container, name, (const RFC_CHAR*)*valueU16, valueU16.length(), &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  // Streamed tables are still read from the handle after the callback
+  if (baton->options.tableMode != TABLE_STREAM) {
+    RFC_ERROR_INFO resetErrorInfo;
+    baton->reusable = plan.Reset(baton->functionHandle, &resetErrorInfo);
   }
+}
 
-  return scope.Escape(Nan::Null());
+/**
+ * Whether the connection is broken or closed after a call failed with this error
+ */
+static bool IsConnectionError(const RFC_ERROR_INFO &errorInfo)
+{
+  return errorInfo.group == COMMUNICATION_FAILURE || errorInfo.group == ABAP_RUNTIME_FAILURE ||
+         errorInfo.group == LOGON_FAILURE || errorInfo.code == RFC_INVALID_HANDLE || errorInfo.code == RFC_CLOSED;
 }
 
-v8::Local<v8::Value> Function::ByteToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value, unsigned len)
+static void SetNotExecutedError(RFC_ERROR_INFO *errorInfo)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  errorInfo->code = RFC_ILLEGAL_STATE;
+  errorInfo->group = EXTERNAL_RUNTIME_FAILURE;
+  strncpyU(errorInfo->key, cU("RFC_NOT_EXECUTED"), sizeof(errorInfo->key) / sizeof(SAP_UC) - 1);
+  strncpyU(errorInfo->message, cU("Not executed, an earlier call of the batch lost the connection"),
+           sizeof(errorInfo->message) / sizeof(SAP_UC) - 1);
+}
 
-  if (!node::Buffer::HasInstance(value)) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
+/**
+ * Runs all calls of a batch on one connection, reusing the function handle.
+ * Stops at the first call that breaks the connection.
+ */
+void Function::EIO_InvokeBatch(uv_work_t *req)
+{
+  int isValid;
 
-  unsigned int bufferLength = node::Buffer::Length(value);
-  if (bufferLength > len) {
-    return ESCAPE_RFC_ERROR("Argument exceeds maximum length: ", name);
-  }
+  BatchBaton *baton = static_cast<BatchBaton*>(req->data);
+  assert(baton != nullptr);
+  assert(baton->functionHandle != nullptr);
 
-  SAP_RAW* bufferData = reinterpret_cast<SAP_RAW*>(node::Buffer::Data(value));
+  const FunctionPlan &plan = *baton->function->plan;
 
-  rc = RfcSetBytes(container, name, bufferData, len, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  RFC_CONNECTION_HANDLE connectionHandle;
+  if (baton->pool != nullptr) {
+    connectionHandle = baton->pool->Acquire(&baton->errorInfo);
+    if (connectionHandle == nullptr) {
+      return;
+    }
+  } else {
+    baton->connection->LockMutex();
+    connectionHandle = baton->connection->GetConnectionHandle();
   }
 
-  return scope.Escape(Nan::Null());
-}
+  bool connectionLost = false;
+  for (unsigned int i = 0; i < baton->items.size(); i++) {
+    BatchItem &item = baton->items[i];
+
+    if (connectionLost) {
+      SetNotExecutedError(&item.errorInfo);
+      continue;
+    }
+    if (i > 0 && !plan.Reset(baton->functionHandle, &item.errorInfo)) {
+      continue;
+    }
+    if (!EncodeParameters(baton->functionHandle, plan, item.inputs, &item.errorInfo)) {
+      continue;
+    }
 
+    RfcInvoke(connectionHandle, baton->functionHandle, &item.errorInfo);
 
-v8::Local<v8::Value> Function::IntToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+    // If handle is invalid, fetch a better error message
+    if (item.errorInfo.code == RFC_INVALID_HANDLE) {
+      RfcIsConnectionHandleValid(connectionHandle, &isValid, &item.errorInfo);
+    }
 
-  if (!value->IsInt32()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
+    if (item.errorInfo.code != RFC_OK && IsConnectionError(item.errorInfo)) {
+      connectionLost = true;
+    } else if (item.errorInfo.code == RFC_OK) {
+      DecodeResults(baton->functionHandle, plan, baton->options, baton->arena, item.results, &item.decodeErrorInfo);
+    }
   }
-  RFC_INT rfcValue = value->ToInt32()->Value();
 
-  rc = RfcSetInt(container, name, rfcValue, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (baton->pool != nullptr) {
+    baton->pool->Release(connectionHandle);
+  } else {
+    baton->connection->UnlockMutex();
   }
 
-  return scope.Escape(Nan::Null());
+  RFC_ERROR_INFO resetErrorInfo;
+  baton->reusable = plan.Reset(baton->functionHandle, &resetErrorInfo);
 }
 
-v8::Local<v8::Value> Function::Int1ToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
+/**
+ * Writes the input snapshot to the function handle, on the worker thread
+ */
+bool Function::EncodeParameters(RFC_FUNCTION_HANDLE functionHandle, const FunctionPlan &plan,
+                                std::vector<NativeValue> &inputs, RFC_ERROR_INFO *errorInfo)
 {
-  Nan::EscapableHandleScope scope;
   RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  const std::vector<FieldPlan> &parameters = plan.parameters;
 
-  if (!value->IsInt32()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
-  int32_t convertedValue = value->ToInt32()->Value();
-  if ((convertedValue < INT8_MIN) || (convertedValue > INT8_MAX)) {
-    return ESCAPE_RFC_ERROR("Argument out of range: ", name);
-  }
-  RFC_INT1 rfcValue = convertedValue;
+  for (unsigned int i = 0; i < parameters.size(); i++) {
+    const FieldPlan &parameter = parameters[i];
+    NativeValue &input = inputs[i];
 
-  rc = RfcSetInt1(container, name, rfcValue, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+    if (input.kind != NativeValue::VALUE_NULL) {
+      bool encoded = input.Encode(functionHandle, parameter, errorInfo);
+      input.Free();
+      if (!encoded) {
+        return false;
+      }
+    }
+
+    rc = RfcSetParameterActive(functionHandle, parameter.name, true, errorInfo);
+    if (rc != RFC_OK) {
+      return false;
+    }
   }
 
-  return scope.Escape(Nan::Null());
+  return true;
 }
 
-v8::Local<v8::Value> Function::Int2ToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
+/**
+ * Copies all results out of the function handle, still on the worker thread
+ */
+void Function::DecodeResults(RFC_FUNCTION_HANDLE functionHandle, const FunctionPlan &plan, const InvocationOptions &options,
+                             Arena &arena, std::vector<NativeValue> &results, RFC_ERROR_INFO *errorInfo)
 {
-  Nan::EscapableHandleScope scope;
   RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  const std::vector<FieldPlan> &parameters = plan.parameters;
 
-  if (!value->IsInt32()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
+  memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+  results.resize(parameters.size());
 
-  int32_t convertedValue = value->ToInt32()->Value();
-  if ((convertedValue < INT16_MIN) || (convertedValue > INT16_MAX)) {
-    return ESCAPE_RFC_ERROR("Argument out of range: ", name);
-  }
-  RFC_INT2 rfcValue = convertedValue;
+  for (unsigned int i = 0; i < parameters.size(); i++) {
+    const FieldPlan &parameter = parameters[i];
+    NativeValue &result = results[i];
 
-  rc = RfcSetInt2(container, name, rfcValue, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+    if (parameter.type == RFCTYPE_TABLE && options.tableMode == TABLE_STREAM) {
+      // Read by the table cursor later on
+      continue;
+    }
+
+    if (parameter.type == RFCTYPE_TABLE && options.tableMode == TABLE_COLUMNS) {
+      RFC_TABLE_HANDLE tableHandle;
+      rc = RfcGetTable(functionHandle, parameter.name, &tableHandle, errorInfo);
+      if (rc != RFC_OK) {
+        return;
+      }
+      result.kind = NativeValue::VALUE_COLUMNS;
+      result.columns = new ColumnarTable();
+      if (!result.columns->Fill(tableHandle, *parameter.typePlan, options.decode.rtrim, errorInfo)) {
+        return;
+      }
+      continue;
+    }
 
-  return scope.Escape(Nan::Null());
+    if (!result.Decode(functionHandle, parameter, options.decode, arena, errorInfo)) {
+      return;
+    }
+  }
 }
 
-v8::Local<v8::Value> Function::FloatToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
+void Function::EIO_AfterInvoke(uv_work_t *req, int status)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
   RFC_ERROR_INFO errorInfo;
 
-  if (!value->IsNumber()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
-  RFC_FLOAT rfcValue = value->ToNumber()->Value();
+  InvocationBaton *baton = static_cast<InvocationBaton*>(req->data);
+  assert(baton != nullptr);
 
-  rc = RfcSetFloat(container, name, rfcValue, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+  napi_env env = baton->function->env;
+  HandleScope scope(env);
 
-  return scope.Escape(Nan::Null());
-}
+  napi_value argv[2];
+  argv[0] = Null(env);
+  argv[1] = Null(env);
 
-v8::Local<v8::Value> Function::DateToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
+  // Taken out of its queue by a timeout or abort, it never ran
+  if (status == UV_ECANCELED && baton->cancellation != nullptr) {
+    baton->cancellation->GetError(&baton->errorInfo);
+  }
+
+  if (baton->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, baton->errorInfo);
+  }
 
-  if (!value->IsString()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
+  // Streamed tables are read after the callback, they keep the function handle alive
+  SharedFunctionHandle *sharedHandle = nullptr;
+  if (baton->options.tableMode == TABLE_STREAM) {
+    sharedHandle = new SharedFunctionHandle(baton->functionHandle);
   }
 
-  v8::Local<v8::String> str = value->ToString();
-  if (str->Length() != 8) {
-    return ESCAPE_RFC_ERROR("Invalid date format: ", name);
+  napi_value result = baton->function->DoReceive(baton->results, baton->decodeErrorInfo, baton->options, sharedHandle);
+  if (IsException(env, result)) {
+    argv[0] = result;
+  } else {
+    argv[1] = result;
   }
 
-  v8::String::Value rfcValue(str);
-  assert(*rfcValue);
-  RFC_RC rc = RfcSetDate(container, name, (const RFC_CHAR*)*rfcValue, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (sharedHandle) {
+    sharedHandle->Unref();
+  } else if (baton->reusable) {
+    baton->function->ReleaseHandle(baton->functionHandle);
+  } else if (baton->functionHandle) {
+    RfcDestroyFunction(baton->functionHandle, &errorInfo);
   }
+  baton->functionHandle = nullptr;
+
+  baton->completion->Complete(2, argv);
 
-  return scope.Escape(Nan::Null());
+  delete baton;
+  delete req;
 }
 
-v8::Local<v8::Value> Function::TimeToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
+void Function::EIO_AfterInvokeBatch(uv_work_t *req)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
+  BatchBaton *baton = static_cast<BatchBaton*>(req->data);
+  assert(baton != nullptr);
 
-  if (!value->IsString()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
-  }
+  napi_env env = baton->function->env;
+  HandleScope scope(env);
 
-  v8::Local<v8::String> str = value->ToString();
-  if (str->Length() != 6) {
-    return ESCAPE_RFC_ERROR("Invalid time format: ", name);
+  napi_value argv[2];
+  argv[0] = Null(env);
+  argv[1] = Null(env);
+
+  if (baton->errorInfo.code != RFC_OK) {
+    argv[0] = RfcError(env, baton->errorInfo);
+  } else {
+    // Every call yields either its result object or its own error
+    napi_value results = NewArray(env, baton->items.size());
+    for (unsigned int i = 0; i < baton->items.size(); i++) {
+      BatchItem &item = baton->items[i];
+      if (item.errorInfo.code != RFC_OK) {
+        Set(env, results, i, RfcError(env, item.errorInfo));
+      } else {
+        Set(env, results, i, baton->function->DoReceive(item.results, item.decodeErrorInfo, baton->options, nullptr));
+      }
+    }
+    argv[1] = results;
   }
 
-  v8::String::Value rfcValue(str);
-  assert(*rfcValue);
-  RFC_RC rc = RfcSetTime(container, name, (const RFC_CHAR*)*rfcValue, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (baton->reusable) {
+    baton->function->ReleaseHandle(baton->functionHandle);
+    baton->functionHandle = nullptr;
   }
 
-  return scope.Escape(Nan::Null());
+  baton->completion->Complete(2, argv);
+
+  delete baton;
+  delete req;
 }
 
-v8::Local<v8::Value> Function::BCDToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value)
+napi_value Function::DoReceive(std::vector<NativeValue> &results, const RFC_ERROR_INFO &decodeErrorInfo,
+                               const InvocationOptions &options, SharedFunctionHandle *sharedHandle)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
+  napi_env env = this->env;
+  EscapableHandleScope scope(env);
+
+  if (decodeErrorInfo.code != RFC_OK) {
+    return scope.Escape(RfcError(env, decodeErrorInfo));
+  }
 
-  if (!value->IsNumber()) {
-    return ESCAPE_RFC_ERROR("Argument has unexpected type: ", name);
+  // Nothing has been decoded if the invocation did not take place
+  if (results.size() != this->plan->parameters.size()) {
+    return scope.Escape(Null(env));
   }
 
-  v8::String::Value valueU16(value->ToString());
+  napi_value result = NewObject(env);
 
-  rc = RfcSetString(container, name, (const SAP_UC*)*valueU16, valueU16.length(), &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  // Get resulting values for exporting/changing/table parameters
+  for (unsigned int i = 0; i < this->plan->parameters.size(); i++) {
+    const FieldPlan &parameter = this->plan->parameters[i];
+    napi_value parmValue;
+
+    switch (parameter.direction) {
+      case RFC_IMPORT:
+        //break;
+      case RFC_CHANGING:
+      case RFC_TABLES:
+      case RFC_EXPORT:
+        if (parameter.type == RFCTYPE_TABLE && sharedHandle != nullptr) {
+          parmValue = TableCursor::NewInstance(this, sharedHandle, parameter, options.batchSize, options.decode);
+        } else if (options.decode.skipEmpty && results[i].kind == NativeValue::VALUE_NULL) {
+          break;
+        } else {
+          parmValue = results[i].ToJS(env);
+        }
+        if (IsException(env, parmValue)) {
+          return scope.Escape(parmValue);
+        }
+        Set(env, result, this->plan->names.Get(env, i), parmValue);
+        break;
+      default:
+        assert(0);
+        break;
+    }
   }
 
-  return scope.Escape(Nan::Null());
+  return scope.Escape(result);
 }
 
-v8::Local<v8::Value> Function::GetValue(const CHND container, RFCTYPE type, const SAP_UC *name, unsigned len)
+napi_value Function::SetValue(NativeValue &target, const FieldPlan &field, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  v8::Local<v8::Value> value = Nan::Null();
+  napi_env env = this->env;
+  EscapableHandleScope scope(env);
+  const SAP_UC *name = field.name;
+  unsigned len = field.nucLength;
+
+  napi_value result = Undefined(env);
 
-  switch (type) {
+  switch (field.type) {
     case RFCTYPE_DATE:
-      value = this->DateToInternal(container, name);
+      result = this->DateToExternal(target, name, value, storage);
       break;
     case RFCTYPE_TIME:
-      value = this->TimeToInternal(container, name);
+      result = this->TimeToExternal(target, name, value, storage);
       break;
     case RFCTYPE_NUM:
-      value = this->NumToInternal(container, name, len);
+      result = this->NumToExternal(target, name, value, len, storage);
       break;
     case RFCTYPE_BCD:
-      value = this->BCDToInternal(container, name);
+    case RFCTYPE_DECF16:
+    case RFCTYPE_DECF34:
+      result = this->BCDToExternal(target, name, value, field.decimals, storage);
       break;
     case RFCTYPE_CHAR:
-      value = this->CharToInternal(container, name, len);
+      result = this->CharToExternal(target, name, value, len, storage);
       break;
     case RFCTYPE_BYTE:
-      value = this->ByteToInternal(container, name, len);
+      result = this->ByteToExternal(target, name, value, len, storage);
       break;
     case RFCTYPE_FLOAT:
-      value = this->FloatToInternal(container, name);
+      result = this->FloatToExternal(target, name, value);
       break;
     case RFCTYPE_INT:
-      value = this->IntToInternal(container, name);
+      result = this->IntToExternal(target, name, value);
       break;
     case RFCTYPE_INT1:
-      value = this->Int1ToInternal(container, name);
+      result = this->Int1ToExternal(target, name, value);
       break;
     case RFCTYPE_INT2:
-      value = this->Int2ToInternal(container, name);
+      result = this->Int2ToExternal(target, name, value);
+      break;
+    case RFCTYPE_INT8:
+      result = this->Int8ToExternal(target, name, value);
+      break;
+    case RFCTYPE_UTCLONG:
+      result = this->StringToExternal(target, name, value, storage);
       break;
     case RFCTYPE_STRUCTURE:
-      value = this->StructureToInternal(container, name);
+      result = this->StructureToExternal(target, field, value, storage);
       break;
     case RFCTYPE_TABLE:
-      value = this->TableToInternal(container, name);
+      result = this->TableToExternal(target, field, value, storage);
       break;
     case RFCTYPE_STRING:
-      value = this->StringToInternal(container, name);
+      result = this->StringToExternal(target, name, value, storage);
       break;
     case RFCTYPE_XSTRING:
-      value = this->XStringToInternal(container, name);
+      result = this->XStringToExternal(target, name, value, storage);
       break;
     default:
       // Type not implemented
-      return ESCAPE_RFC_ERROR("RFC type not implemented: ", Nan::New<v8::Uint32>(type)->ToString());
+      return scope.Escape(RfcError(env, "RFC type not implemented: ", Uint32(env, field.type)));
       break;
   }
 
-  return scope.Escape(value);
+  if (IsException(env, result)) {
+    return scope.Escape(result);
+  }
+
+  return scope.Escape(Null(env));
 }
 
-v8::Local<v8::Value> Function::StructureToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::StructureToExternal(NativeValue &target, const FieldPlan &field, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_RC rc = RFC_OK;
-  RFC_STRUCTURE_HANDLE strucHandle;
-
-  rc = RfcGetStructure(container, name, &strucHandle, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+  assert(field.typePlan);
+  target.kind = NativeValue::VALUE_STRUCTURE;
+  target.structure = new NativeStructure(*field.typePlan, storage.arena);
+  target.structure->fields.resize(field.typePlan->fields.size());
 
-  return scope.Escape(this->StructureToInternal(container, strucHandle));
+  return this->StructureToExternal(target.structure->fields.data(), field, value, storage);
 }
 
-v8::Local<v8::Value> Function::StructureToInternal(const CHND container, const RFC_STRUCTURE_HANDLE struc)
+/**
+ * Snapshots the fields present in value into the row starting at fields
+ */
+napi_value Function::StructureToExternal(NativeValue *fields, const FieldPlan &field, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_RC rc = RFC_OK;
-  RFC_TYPE_DESC_HANDLE typeHandle;
-  RFC_FIELD_DESC fieldDesc;
-  unsigned fieldCount;
-
-  typeHandle = RfcDescribeType(struc, &errorInfo);
-  assert(typeHandle);
-  if (typeHandle == nullptr) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+  napi_env env = this->env;
+  EscapableHandleScope scope(env);
 
-  rc = RfcGetFieldCount(typeHandle, &fieldCount, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsObject(env, value)) {
+    return scope.Escape(RfcError(env, "Argument has unexpected type: ", field.name));
   }
 
-  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  assert(field.typePlan);
+  const std::vector<FieldPlan> &fieldPlans = field.typePlan->fields;
 
-  for (unsigned int i = 0; i < fieldCount; i++) {
-    rc = RfcGetFieldDescByIndex(typeHandle, i, &fieldDesc, &errorInfo);
-    if (rc != RFC_OK) {
-      return ESCAPE_RFC_ERROR(errorInfo);
-    }
+  for (unsigned int i = 0; i < fieldPlans.size(); i++) {
+    napi_value fieldName = field.typePlan->names.Get(env, i);
 
-    v8::Local<v8::Value> value = this->GetValue(struc, fieldDesc.type, fieldDesc.name, fieldDesc.nucLength);
-    // Bail out on exception
-    if (IsException(value)) {
-      return scope.Escape(value);
+    if (Has(env, value, fieldName)) {
+      napi_value result = this->SetValue(fields[i], fieldPlans[i], Get(env, value, fieldName), storage);
+      // Bail out on exception
+      if (IsException(env, result)) {
+        return scope.Escape(result);
+      }
     }
-    obj->Set(Nan::New<v8::String>((const uint16_t*)(fieldDesc.name)).ToLocalChecked(), value);
   }
 
-  return scope.Escape(obj);
+  return scope.Escape(Null(env));
 }
 
-v8::Local<v8::Value> Function::TableToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::TableToExternal(NativeValue &target, const FieldPlan &field, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_RC rc = RFC_OK;
-  RFC_TABLE_HANDLE tableHandle;
-  RFC_STRUCTURE_HANDLE strucHandle;
-  unsigned rowCount;
-
-  rc = RfcGetTable(container, name, &tableHandle, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+  napi_env env = this->env;
+  EscapableHandleScope scope(env);
+  uint32_t rowCount;
 
-  rc = RfcGetRowCount(tableHandle, &rowCount, nullptr);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsArray(env, value)) {
+    return scope.Escape(RfcError(env, "Argument has unexpected type: ", field.name));
   }
 
-  // Create array holding table lines
-  v8::Local<v8::Array> obj = Nan::New<v8::Array>();
+  rowCount = ArrayLength(env, value);
 
-  for (unsigned int i = 0; i < rowCount; i++){
-    RfcMoveTo(tableHandle, i, nullptr);
-    strucHandle = RfcGetCurrentRow(tableHandle, nullptr);
+  assert(field.typePlan);
+  const unsigned int fieldCount = field.typePlan->fields.size();
+  target.kind = NativeValue::VALUE_TABLE;
+  target.table = new NativeTable(*field.typePlan, storage.arena);
+  target.table->Resize(rowCount);
 
-    v8::Local<v8::Value> line = this->StructureToInternal(container, strucHandle);
+  for (uint32_t i = 0; i < rowCount; i++){
+    napi_value line = this->StructureToExternal(target.table->cells.data() + (size_t)i * fieldCount, field, Get(env, value, i), storage);
     // Bail out on exception
-    if (IsException(line)) {
+    if (IsException(env, line)) {
       return scope.Escape(line);
     }
-    obj->Set(i, line);
   }
 
-  return scope.Escape(obj);
+  return scope.Escape(Null(env));
 }
 
-v8::Local<v8::Value> Function::StringToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::StringToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-  unsigned strLen, retStrLen;
+  napi_env env = this->env;
 
-  rc = RfcGetStringLength(container, name, &strLen, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsString(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  if (strLen == 0) {
-    return scope.Escape(Nan::EmptyString());
-  }
+  target.CopyString(env, value, storage.arena);
+
+  return Null(env);
+}
 
-  SAP_UC *buffer = static_cast<SAP_UC*>(malloc((strLen + 1) * sizeof(SAP_UC)));
-  assert(buffer);
-  memset(buffer, 0, (strLen + 1) * sizeof(SAP_UC));
+napi_value Function::XStringToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage)
+{
+  napi_env env = this->env;
 
-  rc = RfcGetString(container, name, buffer, strLen + 1, &retStrLen, &errorInfo);
-  if (rc != RFC_OK) {
-    free(buffer);
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsBuffer(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  v8::Local<v8::String> value = Nan::New<v8::String>((const uint16_t*)(buffer)).ToLocalChecked();
-
-  free(buffer);
+  // Read in place by the worker thread
+  storage.Pin(env, target, value);
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::XStringToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::NumToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned len, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-  unsigned strLen, retStrLen;
-
-  rc = RfcGetStringLength(container, name, &strLen, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
-  }
+  napi_env env = this->env;
 
-  if (strLen == 0) {
-    return scope.Escape(Nan::EmptyString());
+  if (!IsString(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  SAP_RAW *buffer = static_cast<SAP_RAW*>(malloc(strLen * sizeof(SAP_RAW)));
-  assert(buffer);
-  memset(buffer, 0, strLen * sizeof(SAP_RAW));
-
-  rc = RfcGetXString(container, name, buffer, strLen, &retStrLen, &errorInfo);
-  if (rc != RFC_OK) {
-    free(buffer);
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (StringLength(env, value) > len) {
+    RETURN_RFC_ERROR("Argument exceeds maximum length: ", name);
   }
 
-  v8::Local<v8::Value> value = Nan::NewBuffer(reinterpret_cast<char*>(buffer), strLen).ToLocalChecked();
+  target.CopyString(env, value, storage.arena);
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::NumToInternal(const CHND container, const SAP_UC *name, unsigned len)
+napi_value Function::CharToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned len, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
+  napi_env env = this->env;
 
-  RFC_NUM *buffer = static_cast<RFC_NUM*>(malloc((len + 1) * sizeof(RFC_NUM)));
-  assert(buffer);
-  memset(buffer, 0, (len + 1) * sizeof(RFC_NUM));
-
-  RFC_RC rc = RfcGetNum(container, name, buffer, len, &errorInfo);
-  if (rc != RFC_OK) {
-    free(buffer);
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsString(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  v8::Local<v8::String> value = Nan::New<v8::String>((const uint16_t*)(buffer)).ToLocalChecked();
+  if (StringLength(env, value) > len) {
+    RETURN_RFC_ERROR("Argument exceeds maximum length: ", name);
+  }
 
-  free(buffer);
+  target.CopyString(env, value, storage.arena);
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::CharToInternal(const CHND container, const SAP_UC *name, unsigned len)
+napi_value Function::ByteToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned len, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
+  napi_env env = this->env;
 
-  RFC_CHAR *buffer = static_cast<RFC_CHAR*>(malloc((len + 1) * sizeof(RFC_CHAR)));
-  assert(buffer);
-  memset(buffer, 0, (len + 1) * sizeof(RFC_CHAR));
-
-  RFC_RC rc = RfcGetChars(container, name, buffer, len, &errorInfo);
-  if (rc != RFC_OK) {
-    free(buffer);
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsBuffer(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  v8::Local<v8::String> value = Nan::New<v8::String>((const uint16_t*)(buffer)).ToLocalChecked();
+  void *data = nullptr;
+  size_t bufferLength = 0;
+  napi_get_buffer_info(env, value, &data, &bufferLength);
+  if (bufferLength > len) {
+    RETURN_RFC_ERROR("Argument exceeds maximum length: ", name);
+  }
 
-  free(buffer);
+  if (bufferLength == len) {
+    storage.Pin(env, target, value);
+  } else {
+    // Shorter values are padded with zeros to the field length
+    target.CopyBytes(static_cast<const char*>(data), bufferLength, len);
+  }
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::ByteToInternal(const CHND container, const SAP_UC *name, unsigned len)
-{
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
 
-  RFC_BYTE *buffer = static_cast<RFC_BYTE*>(malloc(len * sizeof(RFC_BYTE)));
-  assert(buffer);
-  memset(buffer, 0, len * sizeof(RFC_BYTE));
+napi_value Function::IntToExternal(NativeValue &target, const SAP_UC *name, napi_value value)
+{
+  napi_env env = this->env;
 
-  RFC_RC rc = RfcGetBytes(container, name, buffer, len, &errorInfo);
-  if (rc != RFC_OK) {
-    free(buffer);
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsInt32(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  v8::Local<v8::Value> value = Nan::NewBuffer(reinterpret_cast<char*>(buffer), len).ToLocalChecked();
+  target.kind = NativeValue::VALUE_INTEGER;
+  target.integer = Int32Value(env, value);
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::IntToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::Int1ToExternal(NativeValue &target, const SAP_UC *name, napi_value value)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_INT value;
+  napi_env env = this->env;
 
-  RFC_RC rc = RfcGetInt(container, name, &value, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsInt32(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
+  }
+  int32_t convertedValue = Int32Value(env, value);
+  if ((convertedValue < INT8_MIN) || (convertedValue > INT8_MAX)) {
+    RETURN_RFC_ERROR("Argument out of range: ", name);
   }
 
-  return scope.Escape(Nan::New<v8::Integer>(value));
+  target.kind = NativeValue::VALUE_INTEGER;
+  target.integer = convertedValue;
+
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::Int1ToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::Int2ToExternal(NativeValue &target, const SAP_UC *name, napi_value value)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_INT1 value;
+  napi_env env = this->env;
 
-  RFC_RC rc = RfcGetInt1(container, name, &value, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsInt32(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
+  }
+
+  int32_t convertedValue = Int32Value(env, value);
+  if ((convertedValue < INT16_MIN) || (convertedValue > INT16_MAX)) {
+    RETURN_RFC_ERROR("Argument out of range: ", name);
   }
 
-  return scope.Escape(Nan::New<v8::Integer>(value));
+  target.kind = NativeValue::VALUE_INTEGER;
+  target.integer = convertedValue;
+
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::Int2ToInternal(const CHND container, const SAP_UC *name)
+/**
+ * Accepts integral numbers and BigInts
+ */
+napi_value Function::Int8ToExternal(NativeValue &target, const SAP_UC *name, napi_value value)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_INT2 value;
+  napi_env env = this->env;
+  int64_t convertedValue;
+
+  if (IsBigInt(env, value)) {
+    bool lossless = false;
+    napi_get_value_bigint_int64(env, value, &convertedValue, &lossless);
+    if (!lossless) {
+      RETURN_RFC_ERROR("Argument out of range: ", name);
+    }
 
-  RFC_RC rc = RfcGetInt2(container, name, &value, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+    target.kind = NativeValue::VALUE_INT64;
+    target.integer64 = convertedValue;
+
+    return Null(env);
+  }
+
+  if (!IsNumber(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
+  }
+
+  double number = NumberValue(env, value);
+  // 2^63 is the first double above the range
+  if (number != floor(number) || number < -9223372036854775808.0 || number >= 9223372036854775808.0) {
+    RETURN_RFC_ERROR("Argument out of range: ", name);
   }
+  convertedValue = static_cast<int64_t>(number);
+
+  target.kind = NativeValue::VALUE_INT64;
+  target.integer64 = convertedValue;
 
-  return scope.Escape(Nan::New<v8::Integer>(value));
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::FloatToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::FloatToExternal(NativeValue &target, const SAP_UC *name, napi_value value)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_FLOAT value;
+  napi_env env = this->env;
 
-  RFC_RC rc = RfcGetFloat(container, name, &value, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsNumber(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
   }
 
-  return scope.Escape(Nan::New<v8::Number>(value));
+  target.kind = NativeValue::VALUE_NUMBER;
+  target.number = NumberValue(env, value);
+
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::DateToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::DateToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_DATE date = { 0 };
+  napi_env env = this->env;
 
-  RFC_RC rc = RfcGetDate(container, name, date, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsString(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
+  }
+
+  if (StringLength(env, value) != 8) {
+    RETURN_RFC_ERROR("Invalid date format: ", name);
   }
 
-  assert(sizeof(RFC_CHAR) > 0); // Shouldn't occur except in case of a compiler glitch
-  v8::Local<v8::String> value = Nan::New<v8::String>(
-    (const uint16_t*)(date), (unsigned)(sizeof(RFC_DATE) / sizeof(RFC_CHAR))).ToLocalChecked();
+  target.CopyString(env, value, storage.arena);
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::TimeToInternal(const CHND container, const SAP_UC *name)
+napi_value Function::TimeToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_ERROR_INFO errorInfo;
-  RFC_TIME time = { 0 };
+  napi_env env = this->env;
 
-  RFC_RC rc = RfcGetTime(container, name, time, &errorInfo);
-  if (rc != RFC_OK) {
-    return ESCAPE_RFC_ERROR(errorInfo);
+  if (!IsString(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
+  }
+
+  if (StringLength(env, value) != 6) {
+    RETURN_RFC_ERROR("Invalid time format: ", name);
   }
 
-  assert(sizeof(RFC_CHAR) > 0); // Shouldn't occur except in case of a compiler glitch
-  v8::Local<v8::String> value = Nan::New<v8::String>(
-    (const uint16_t*)(time), (unsigned)(sizeof(RFC_TIME) / sizeof(RFC_CHAR))).ToLocalChecked();
+  target.CopyString(env, value, storage.arena);
 
-  return scope.Escape(value);
+  return Null(env);
 }
 
-v8::Local<v8::Value> Function::BCDToInternal(const CHND container, const SAP_UC *name)
+/**
+ * Accepts numbers, decimal strings, which are passed on exactly, and BigInts
+ * scaled by the decimals of the field
+ */
+napi_value Function::BCDToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned decimals, InputStorage &storage)
 {
-  Nan::EscapableHandleScope scope;
-  RFC_RC rc = RFC_OK;
-  RFC_ERROR_INFO errorInfo;
-  unsigned strLen = 25;
-  unsigned retStrLen;
-  SAP_UC *buffer;
-
-  do {
-    buffer = static_cast<SAP_UC*>(malloc((strLen + 1) * sizeof(SAP_UC)));
-    assert(buffer);
-    memset(buffer, 0, (strLen + 1) * sizeof(SAP_UC));
-
-    rc = RfcGetString(container, name, buffer, strLen + 1, &retStrLen, &errorInfo);
-
-    if (rc == RFC_BUFFER_TOO_SMALL) {
-      // Retry with suggested string length
-      free(buffer);
-      strLen = retStrLen;
-    } else if (rc != RFC_OK) {
-      free(buffer);
-      return ESCAPE_RFC_ERROR(errorInfo);
+  napi_env env = this->env;
+
+  if (IsBigInt(env, value)) {
+    std::string digits = convertToString(env, value);
+    std::string sign;
+    if (!digits.empty() && digits[0] == '-') {
+      sign = "-";
+      digits.erase(0, 1);
+    }
+    if (decimals > 0) {
+      if (digits.length() <= decimals) {
+        digits.insert(0, decimals + 1 - digits.length(), '0');
+      }
+      digits.insert(digits.length() - decimals, ".");
     }
-  } while (rc == RFC_BUFFER_TOO_SMALL);
+    target.CopyString(env, NewString(env, (sign + digits).c_str()), storage.arena);
+
+    return Null(env);
+  }
 
-  v8::Local<v8::String> value = Nan::New<v8::String>((const uint16_t*)(buffer), retStrLen).ToLocalChecked();
+  if (!IsNumber(env, value) && !IsString(env, value)) {
+    RETURN_RFC_ERROR("Argument has unexpected type: ", name);
+  }
 
-  free(buffer);
+  // Numbers are passed on in their shortest round trip form
+  napi_value str;
+  napi_coerce_to_string(env, value, &str);
+  target.CopyString(env, str, storage.arena);
 
-  return scope.Escape(value->ToNumber());
+  return Null(env);
 }
 
 std::string Function::mapExternalTypeToJavaScriptType(RFCTYPE sapType)
@@ -1208,6 +1483,7 @@ std::string Function::mapExternalTypeToJavaScriptType(RFCTYPE sapType)
     case RFCTYPE_NUM:
     case RFCTYPE_STRING:
     case RFCTYPE_XSTRING:
+    case RFCTYPE_UTCLONG:
       return "string";
     case RFCTYPE_TABLE:
       return "array";
@@ -1223,7 +1499,6 @@ std::string Function::mapExternalTypeToJavaScriptType(RFCTYPE sapType)
     case RFCTYPE_INT2:
     case RFCTYPE_INT1:
     case RFCTYPE_INT8:
-    case RFCTYPE_UTCLONG:
     case RFCTYPE_UTCSECOND:
     case RFCTYPE_UTCMINUTE:
     case RFCTYPE_DTDAY:
@@ -1239,41 +1514,35 @@ std::string Function::mapExternalTypeToJavaScriptType(RFCTYPE sapType)
 
 }
 
-bool Function::addMetaData(const CHND container, v8::Local<v8::Object> &parent,
+bool Function::addMetaData(napi_env env, const CHND container, napi_value parent,
                            const RFC_ABAP_NAME name, RFCTYPE type,
-                           unsigned int length, RFC_DIRECTION direction,
+                           unsigned int length, unsigned int decimals, RFC_DIRECTION direction,
                            RFC_ERROR_INFO *errorInfo, RFC_PARAMETER_TEXT paramText)
 {
-  Nan::EscapableHandleScope scope;
+  HandleScope scope(env);
   RFC_RC rc = RFC_OK;
 
-  v8::Local<v8::Object> actualType = Nan::New<v8::Object>();
-  parent->Set(Nan::New<v8::String>((const uint16_t*)name).ToLocalChecked(), actualType);
+  napi_value actualType = NewObject(env);
+  Set(env, parent, NewString(env, name), actualType);
 
-  actualType->Set(
-    Nan::New<v8::String>("type").ToLocalChecked(),
-    Nan::New<v8::String>(mapExternalTypeToJavaScriptType(type).c_str()).ToLocalChecked());
+  Set(env, actualType, "type", NewString(env, mapExternalTypeToJavaScriptType(type).c_str()));
 
   std::stringstream lengthString;
   lengthString << length;
-  actualType->Set(
-    Nan::New<v8::String>("length").ToLocalChecked(),
-    Nan::New<v8::String>(lengthString.str().c_str()).ToLocalChecked());
+  Set(env, actualType, "length", NewString(env, lengthString.str().c_str()));
+
+  if (type == RFCTYPE_BCD) {
+    Set(env, actualType, "decimals", Uint32(env, decimals));
+  }
 
-  actualType->Set(
-    Nan::New<v8::String>("sapType").ToLocalChecked(),
-    Nan::New<v8::String>((uint16_t*)RfcGetTypeAsString(type)).ToLocalChecked());
+  Set(env, actualType, "sapType", NewString(env, RfcGetTypeAsString(type)));
 
   if (paramText != nullptr) {
-	  actualType->Set(
-        Nan::New<v8::String>("description").ToLocalChecked(),
-        Nan::New<v8::String>((const uint16_t*)paramText).ToLocalChecked());
+    Set(env, actualType, "description", NewString(env, paramText));
   }
 
   if (direction != 0) {
-    actualType->Set(
-        Nan::New<v8::String>("sapDirection").ToLocalChecked(),
-        Nan::New<v8::String>((uint16_t*)RfcGetDirectionAsString(direction)).ToLocalChecked());
+    Set(env, actualType, "sapDirection", NewString(env, RfcGetDirectionAsString(direction)));
   }
 
   if (type == RFCTYPE_STRUCTURE) {
@@ -1299,17 +1568,15 @@ bool Function::addMetaData(const CHND container, v8::Local<v8::Object> &parent,
       return false;
   }
 
-  actualType->Set(
-        Nan::New<v8::String>("sapTypeName").ToLocalChecked(),
-        Nan::New<v8::String>((const uint16_t*)typeName).ToLocalChecked());
+  Set(env, actualType, "sapTypeName", NewString(env, typeName));
 
   rc = RfcGetFieldCount(typeHandle, &fieldCount, errorInfo);
   if (rc != RFC_OK) {
     return false;
   }
 
-  v8::Local<v8::Object> properties = Nan::New<v8::Object>();
-    actualType->Set(Nan::New<v8::String>("properties").ToLocalChecked(), properties);
+  napi_value properties = NewObject(env);
+    Set(env, actualType, "properties", properties);
 
     for (unsigned int i = 0; i < fieldCount; i++) {
       rc = RfcGetFieldDescByIndex(typeHandle, i, &fieldDesc, errorInfo);
@@ -1317,8 +1584,8 @@ bool Function::addMetaData(const CHND container, v8::Local<v8::Object> &parent,
         return false;
       }
 
-      if (!addMetaData( strucHandle, properties, fieldDesc.name, fieldDesc.type,
-                   fieldDesc.nucLength, RFC_DIRECTION(0), errorInfo)) {
+      if (!addMetaData(env, strucHandle, properties, fieldDesc.name, fieldDesc.type,
+                   fieldDesc.nucLength, fieldDesc.decimals, RFC_DIRECTION(0), errorInfo)) {
         return false;
       }
     }
@@ -1357,18 +1624,14 @@ bool Function::addMetaData(const CHND container, v8::Local<v8::Object> &parent,
     return false;
   }
 
-  v8::Local<v8::Object> items = Nan::New<v8::Object>();
-  actualType->Set(Nan::New<v8::String>("items").ToLocalChecked(), items);
-  items->Set(
-      Nan::New<v8::String>("sapTypeName").ToLocalChecked(),
-      Nan::New<v8::String>((const uint16_t*)typeName).ToLocalChecked());
+  napi_value items = NewObject(env);
+  Set(env, actualType, "items", items);
+  Set(env, items, "sapTypeName", NewString(env, typeName));
 
-    items->Set(
-      Nan::New<v8::String>("type").ToLocalChecked(),
-      Nan::New<v8::String>("object").ToLocalChecked());
+    Set(env, items, "type", NewString(env, "object"));
 
-    v8::Local<v8::Object> properties = Nan::New<v8::Object>();
-    items->Set(Nan::New<v8::String>("properties").ToLocalChecked(), properties);
+    napi_value properties = NewObject(env);
+    Set(env, items, "properties", properties);
 
     RFC_STRUCTURE_HANDLE rowHandle = RfcAppendNewRow(tableHandle, errorInfo);
     if (rc != RFC_OK) {
@@ -1381,8 +1644,8 @@ bool Function::addMetaData(const CHND container, v8::Local<v8::Object> &parent,
         return false;
       }
 
-      if (!addMetaData( rowHandle, properties, fieldDesc.name, fieldDesc.type,
-                   fieldDesc.nucLength, RFC_DIRECTION(0), errorInfo)) {
+      if (!addMetaData(env, rowHandle, properties, fieldDesc.name, fieldDesc.type,
+                   fieldDesc.nucLength, fieldDesc.decimals, RFC_DIRECTION(0), errorInfo)) {
         return false;
       }
     }
@@ -26,75 +26,141 @@ SOFTWARE.
 #define FUNCTION_H_
 
 #include "Common.h"
-#include <node.h>
-#include <v8.h>
-#include <node_version.h>
+#include "ObjectWrap.h"
 #include <sapnwrfc.h>
 #include "Connection.h"
+#include "ConnectionPool.h"
+#include "FunctionPlan.h"
+#include "MetadataCache.h"
+#include "TableCursor.h"
+#include "ColumnarTable.h"
+#include "NativeValue.h"
+#include "Completion.h"
+#include "Cancellation.h"
 
-class Function : public node::ObjectWrap
+#define DEFAULT_BATCH_SIZE 1000
+#define MAX_IDLE_FUNCTION_HANDLES 4
+
+class Function : public ObjectWrap
 {
   public:
-  static NAN_MODULE_INIT(Init);
-  static v8::Local<v8::Value> NewInstance(Connection &connection, const Nan::NAN_METHOD_ARGS_TYPE args);
+  static void Init(napi_env env, napi_value exports);
+  static napi_value NewInstance(Connection &connection, napi_value functionName);
+  static napi_value NewInstance(ConnectionPool &pool, RFC_CONNECTION_HANDLE connectionHandle, napi_value functionName);
+  // Takes over the completion, which receives the Function object
+  static void LookupAsync(Connection *connection, ConnectionPool *pool, napi_value functionName, Completion *completion);
 
   protected:
   Function();
   ~Function();
 
-  static NAN_METHOD(New);
-  static NAN_METHOD(Invoke);
-  static NAN_METHOD(MetaData);
+  class Description
+  {
+    public:
+    Description() : functionDescHandle(nullptr), plan(nullptr) { };
+    ~Description() {
+      if (this->functionDescHandle) {
+        MetadataCache::Release(this->functionDescHandle);
+      }
+      delete this->plan;
+    };
+
+    bool Fetch(RFC_CONNECTION_HANDLE connectionHandle, const SAP_UC *functionName, RFC_ERROR_INFO *errorInfo);
+
+    RFC_FUNCTION_DESC_HANDLE functionDescHandle;
+    FunctionPlan *plan;
+  };
+
+  enum TableMode {
+    TABLE_ROWS,
+    TABLE_STREAM,
+    TABLE_COLUMNS
+  };
+
+  /**
+   * Per invocation options, see ParseOptions
+   */
+  class InvocationOptions
+  {
+    public:
+    InvocationOptions() : tableMode(TABLE_ROWS), batchSize(DEFAULT_BATCH_SIZE), priority(Connection::PRIORITY_NORMAL), timeout(0) { };
+
+    TableMode tableMode;
+    unsigned int batchSize;
+    // Lane in the queue of the connection, ignored by pools
+    Connection::Priority priority;
+    // Milliseconds until the call is cancelled, 0 for none
+    unsigned int timeout;
+    DecodeOptions decode;
+  };
+
+  // The AbortSignal is returned separately, it must not leave the main thread
+  static bool ParseOptions(napi_env env, napi_value value, InvocationOptions &options, napi_value &signal);
+
+  class InvocationBaton;
+  class BatchBaton;
+
+  // Takes over the plan and the cached function description of the description
+  static napi_value NewInstance(napi_env env, Connection *connection, ConnectionPool *pool, Description &description);
+
+  static NAPI_METHOD(New);
+  static NAPI_METHOD(Invoke);
+  static NAPI_METHOD(InvokeAsync);
+  static NAPI_METHOD(InvokeBatch);
+  static NAPI_METHOD(MetaData);
 
+  static void EIO_Lookup(uv_work_t *req);
+  static void EIO_AfterLookup(uv_work_t *req);
   static void EIO_Invoke(uv_work_t *req);
-  static void EIO_AfterInvoke(uv_work_t *req);
-
-  v8::Local<v8::Value> DoReceive(const CHND container);
-
-  v8::Local<v8::Value> SetValue(const CHND container, RFCTYPE type, const SAP_UC *name, unsigned len, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> StructureToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> StructureToExternal(const CHND container, const RFC_STRUCTURE_HANDLE struc, v8::Local<v8::Value>);
-  v8::Local<v8::Value> TableToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> StringToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> XStringToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> NumToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value, unsigned len);
-  v8::Local<v8::Value> CharToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value, unsigned len);
-  v8::Local<v8::Value> ByteToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value, unsigned len);
-  v8::Local<v8::Value> IntToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> Int1ToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> Int2ToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> FloatToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> TimeToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> DateToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-  v8::Local<v8::Value> BCDToExternal(const CHND container, const SAP_UC *name, v8::Local<v8::Value> value);
-
-  v8::Local<v8::Value> GetValue(const CHND container, RFCTYPE type, const SAP_UC *name, unsigned len);
-  v8::Local<v8::Value> StructureToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> StructureToInternal(const CHND container, const RFC_STRUCTURE_HANDLE struc);
-  v8::Local<v8::Value> TableToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> StringToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> XStringToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> NumToInternal(const CHND container, const SAP_UC *name, unsigned len);
-  v8::Local<v8::Value> CharToInternal(const CHND container, const SAP_UC *name, unsigned len);
-  v8::Local<v8::Value> ByteToInternal(const CHND container, const SAP_UC *name, unsigned len);
-  v8::Local<v8::Value> IntToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> Int1ToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> Int2ToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> FloatToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> DateToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> TimeToInternal(const CHND container, const SAP_UC *name);
-  v8::Local<v8::Value> BCDToInternal(const CHND container, const SAP_UC *name);
+  static void EIO_AfterInvoke(uv_work_t *req, int status);
+  static void EIO_InvokeBatch(uv_work_t *req);
+  static void EIO_AfterInvokeBatch(uv_work_t *req);
+  static bool EncodeParameters(RFC_FUNCTION_HANDLE functionHandle, const FunctionPlan &plan,
+                               std::vector<NativeValue> &inputs, RFC_ERROR_INFO *errorInfo);
+  static void DecodeResults(RFC_FUNCTION_HANDLE functionHandle, const FunctionPlan &plan, const InvocationOptions &options,
+                            Arena &arena, std::vector<NativeValue> &results, RFC_ERROR_INFO *errorInfo);
+
+  // Main thread only, released handles must have been reset
+  RFC_FUNCTION_HANDLE AcquireHandle(RFC_ERROR_INFO *errorInfo);
+  void ReleaseHandle(RFC_FUNCTION_HANDLE functionHandle);
+
+  void QueueInvoke(napi_value params, const InvocationOptions &options, napi_value signal, Completion *completion);
+  napi_value SnapshotInputs(napi_value value, std::vector<NativeValue> &inputs, InputStorage &storage);
+  napi_value DoReceive(std::vector<NativeValue> &results, const RFC_ERROR_INFO &decodeErrorInfo,
+                         const InvocationOptions &options, SharedFunctionHandle *sharedHandle);
+
+  napi_value SetValue(NativeValue &target, const FieldPlan &field, napi_value value, InputStorage &storage);
+  napi_value StructureToExternal(NativeValue &target, const FieldPlan &field, napi_value value, InputStorage &storage);
+  napi_value StructureToExternal(NativeValue *fields, const FieldPlan &field, napi_value value, InputStorage &storage);
+  napi_value TableToExternal(NativeValue &target, const FieldPlan &field, napi_value value, InputStorage &storage);
+  napi_value StringToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage);
+  napi_value XStringToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage);
+  napi_value NumToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned len, InputStorage &storage);
+  napi_value CharToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned len, InputStorage &storage);
+  napi_value ByteToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned len, InputStorage &storage);
+  napi_value IntToExternal(NativeValue &target, const SAP_UC *name, napi_value value);
+  napi_value Int1ToExternal(NativeValue &target, const SAP_UC *name, napi_value value);
+  napi_value Int2ToExternal(NativeValue &target, const SAP_UC *name, napi_value value);
+  napi_value Int8ToExternal(NativeValue &target, const SAP_UC *name, napi_value value);
+  napi_value FloatToExternal(NativeValue &target, const SAP_UC *name, napi_value value);
+  napi_value TimeToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage);
+  napi_value DateToExternal(NativeValue &target, const SAP_UC *name, napi_value value, InputStorage &storage);
+  napi_value BCDToExternal(NativeValue &target, const SAP_UC *name, napi_value value, unsigned decimals, InputStorage &storage);
+
 
   static std::string mapExternalTypeToJavaScriptType(RFCTYPE sapType);
-  static bool addMetaData(const CHND container, v8::Local<v8::Object>& parent,
+  static bool addMetaData(napi_env env, const CHND container, napi_value parent,
                           const RFC_ABAP_NAME name, RFCTYPE type,
-                          unsigned int length, RFC_DIRECTION direction,
+                          unsigned int length, unsigned int decimals, RFC_DIRECTION direction,
                           RFC_ERROR_INFO* errorInfo, RFC_PARAMETER_TEXT paramText = nullptr);
 
   class InvocationBaton
   {
     public:
-    InvocationBaton() : function(nullptr), functionHandle(nullptr) { };
+    InvocationBaton() : function(nullptr), connection(nullptr), pool(nullptr), functionHandle(nullptr), completion(nullptr), cancellation(nullptr), reusable(false) {
+      memset(&this->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+      memset(&this->decodeErrorInfo, 0, sizeof(RFC_ERROR_INFO));
+    };
     ~InvocationBaton() {
       RFC_ERROR_INFO errorInfo;
 
@@ -103,25 +169,154 @@ class Function : public node::ObjectWrap
         this->functionHandle = nullptr;
       }
 
+      for (unsigned int i = 0; i < this->inputs.size(); i++) {
+        this->inputs[i].Free();
+      }
+      for (unsigned int i = 0; i < this->results.size(); i++) {
+        this->results[i].Free();
+      }
+
       if (this->function) {
         this->function->Unref();
       }
+      if (this->connection) {
+        this->connection->Unref();
+      }
+      if (this->pool) {
+        this->pool->Unref();
+      }
 
-      delete this->cbInvoke;
-      this->cbInvoke = nullptr;
+      delete this->completion;
+      this->completion = nullptr;
+
+      if (this->cancellation) {
+        this->cancellation->Dispose();
+        this->cancellation = nullptr;
+      }
     };
 
     Function *function;
     Connection *connection;
+    ConnectionPool *pool;
     RFC_FUNCTION_HANDLE functionHandle;
-    Nan::Callback *cbInvoke;
+    Completion *completion;
+    // Only set if the call has a timeout or an AbortSignal
+    Cancellation *cancellation;
+    InvocationOptions options;
+    // Snapshot on the main thread, encoded on the worker thread
+    std::vector<NativeValue> inputs;
+    InputStorage storage;
+    // Holds the decoded strings
+    Arena arena;
+    // Decoded on the worker thread, indexed like the parameters
+    std::vector<NativeValue> results;
+    RFC_ERROR_INFO errorInfo;
+    RFC_ERROR_INFO decodeErrorInfo;
+    // Set once the function handle has been reset on the worker thread
+    bool reusable;
+  };
+
+  /**
+   * One call of a batch, with its own inputs, results and errors
+   */
+  class BatchItem
+  {
+    public:
+    BatchItem() {
+      memset(&this->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+      memset(&this->decodeErrorInfo, 0, sizeof(RFC_ERROR_INFO));
+    };
+
+    std::vector<NativeValue> inputs;
+    std::vector<NativeValue> results;
     RFC_ERROR_INFO errorInfo;
+    RFC_ERROR_INFO decodeErrorInfo;
   };
 
-  static Nan::Persistent<v8::Function> ctor;
+  class BatchBaton
+  {
+    public:
+    BatchBaton() : function(nullptr), connection(nullptr), pool(nullptr), functionHandle(nullptr), completion(nullptr), reusable(false) {
+      memset(&this->errorInfo, 0, sizeof(RFC_ERROR_INFO));
+    };
+    ~BatchBaton() {
+      RFC_ERROR_INFO errorInfo;
+
+      if (this->functionHandle) {
+        RfcDestroyFunction(this->functionHandle, &errorInfo);
+        this->functionHandle = nullptr;
+      }
+
+      for (unsigned int i = 0; i < this->items.size(); i++) {
+        for (unsigned int j = 0; j < this->items[i].inputs.size(); j++) {
+          this->items[i].inputs[j].Free();
+        }
+        for (unsigned int j = 0; j < this->items[i].results.size(); j++) {
+          this->items[i].results[j].Free();
+        }
+      }
+
+      if (this->function) {
+        this->function->Unref();
+      }
+      if (this->connection) {
+        this->connection->Unref();
+      }
+      if (this->pool) {
+        this->pool->Unref();
+      }
+
+      delete this->completion;
+      this->completion = nullptr;
+    };
+
+    Function *function;
+    Connection *connection;
+    ConnectionPool *pool;
+    // Shared by all calls, reset in between
+    RFC_FUNCTION_HANDLE functionHandle;
+    Completion *completion;
+    InvocationOptions options;
+    InputStorage storage;
+    Arena arena;
+    std::vector<BatchItem> items;
+    // Set if no call took place at all
+    RFC_ERROR_INFO errorInfo;
+    bool reusable;
+  };
+
+  class LookupBaton
+  {
+    public:
+    LookupBaton() : connection(nullptr), pool(nullptr), functionName(nullptr), completion(nullptr) { };
+    ~LookupBaton() {
+      free(this->functionName);
+
+      if (this->connection) {
+        this->connection->Unref();
+      }
+      if (this->pool) {
+        this->pool->Unref();
+      }
+
+      delete this->completion;
+      this->completion = nullptr;
+    };
+
+    Connection *connection;
+    ConnectionPool *pool;
+    SAP_UC *functionName;
+    Description description;
+    Completion *completion;
+    RFC_ERROR_INFO errorInfo;
+  };
 
   Connection *connection;
+  ConnectionPool *pool;
   RFC_FUNCTION_DESC_HANDLE functionDescHandle;
+  FunctionPlan *plan;
+  // Function handles in their initial state, reused instead of creating new ones
+  std::vector<RFC_FUNCTION_HANDLE> idleHandles;
 };
 
 #endif /* FUNCTION_H_ */
@@ -0,0 +1,291 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Common.h"
+#include "FunctionPlan.h"
+
+FieldPlan::FieldPlan() :
+  type(RFCTYPE_CHAR),
+  direction(RFC_DIRECTION(0)),
+  nucLength(0),
+  ucLength(0),
+  nucOffset(0),
+  ucOffset(0),
+  decimals(0),
+  typePlan(nullptr)
+{
+  memset(this->name, 0, sizeof(RFC_ABAP_NAME));
+}
+
+FieldNames::~FieldNames()
+{
+  if (this->keys != nullptr) {
+    napi_delete_reference(this->env, this->keys);
+  }
+}
+
+napi_value FieldNames::Keys(napi_env env) const
+{
+  if (this->keys != nullptr) {
+    return Reference(env, this->keys);
+  }
+
+  napi_value keys = NewArray(env, this->fields.size());
+  for (unsigned int i = 0; i < this->fields.size(); i++) {
+    napi_value key;
+#if NAPI_VERSION >= 10
+    node_api_create_property_key_utf16(env, reinterpret_cast<const char16_t*>(this->fields[i].name), NAPI_AUTO_LENGTH, &key);
+#else
+    key = NewString(env, this->fields[i].name);
+#endif
+    Set(env, keys, i, key);
+  }
+
+  // Without the reference the keys are simply created again next time
+  if (napi_create_reference(env, keys, 1, &this->keys) == napi_ok) {
+    this->env = env;
+  } else {
+    this->keys = nullptr;
+  }
+
+  return keys;
+}
+
+napi_value FieldNames::Get(napi_env env, unsigned int index) const
+{
+  napi_value key;
+  if (napi_get_element(env, this->Keys(env), index, &key) != napi_ok) {
+    return NewString(env, this->fields[index].name);
+  }
+  return key;
+}
+
+/**
+ * Fetches all keys at once, for building many rows in the current handle scope
+ */
+void FieldNames::Load(napi_env env, std::vector<napi_value> &keys) const
+{
+  napi_value array = this->Keys(env);
+
+  keys.resize(this->fields.size());
+  for (unsigned int i = 0; i < this->fields.size(); i++) {
+    if (napi_get_element(env, array, i, &keys[i]) != napi_ok) {
+      keys[i] = NewString(env, this->fields[i].name);
+    }
+  }
+}
+
+FunctionPlan::FunctionPlan() : names(parameters)
+{
+}
+
+FunctionPlan::~FunctionPlan()
+{
+  for (std::map<RFC_TYPE_DESC_HANDLE, TypePlan*>::iterator it = this->types.begin(); it != this->types.end(); ++it) {
+    delete it->second;
+  }
+}
+
+bool FunctionPlan::Compile(RFC_FUNCTION_DESC_HANDLE functionDescHandle, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  unsigned int parmCount;
+
+  rc = RfcGetParameterCount(functionDescHandle, &parmCount, errorInfo);
+  if (rc != RFC_OK) {
+    return false;
+  }
+
+  this->parameters.resize(parmCount);
+
+  for (unsigned int i = 0; i < parmCount; i++) {
+    RFC_PARAMETER_DESC parmDesc;
+    FieldPlan &parameter = this->parameters[i];
+
+    rc = RfcGetParameterDescByIndex(functionDescHandle, i, &parmDesc, errorInfo);
+    if (rc != RFC_OK) {
+      return false;
+    }
+
+    memcpy(parameter.name, parmDesc.name, sizeof(RFC_ABAP_NAME));
+    parameter.type = parmDesc.type;
+    parameter.direction = parmDesc.direction;
+    parameter.nucLength = parmDesc.nucLength;
+    parameter.ucLength = parmDesc.ucLength;
+    parameter.decimals = parmDesc.decimals;
+
+    if (parmDesc.type == RFCTYPE_STRUCTURE || parmDesc.type == RFCTYPE_TABLE) {
+      parameter.typePlan = this->CompileType(parmDesc.typeDescHandle, errorInfo);
+      if (parameter.typePlan == nullptr) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+TypePlan* FunctionPlan::CompileType(RFC_TYPE_DESC_HANDLE typeDescHandle, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  unsigned int fieldCount;
+
+  std::map<RFC_TYPE_DESC_HANDLE, TypePlan*>::iterator it = this->types.find(typeDescHandle);
+  if (it != this->types.end()) {
+    return it->second;
+  }
+
+  TypePlan *typePlan = new TypePlan();
+  typePlan->typeDescHandle = typeDescHandle;
+  this->types[typeDescHandle] = typePlan;
+
+  rc = RfcGetFieldCount(typeDescHandle, &fieldCount, errorInfo);
+  if (rc != RFC_OK) {
+    return nullptr;
+  }
+
+  typePlan->fields.resize(fieldCount);
+
+  for (unsigned int i = 0; i < fieldCount; i++) {
+    RFC_FIELD_DESC fieldDesc;
+    FieldPlan &field = typePlan->fields[i];
+
+    rc = RfcGetFieldDescByIndex(typeDescHandle, i, &fieldDesc, errorInfo);
+    if (rc != RFC_OK) {
+      return nullptr;
+    }
+
+    memcpy(field.name, fieldDesc.name, sizeof(RFC_ABAP_NAME));
+    field.type = fieldDesc.type;
+    field.nucLength = fieldDesc.nucLength;
+    field.ucLength = fieldDesc.ucLength;
+    field.nucOffset = fieldDesc.nucOffset;
+    field.ucOffset = fieldDesc.ucOffset;
+    field.decimals = fieldDesc.decimals;
+
+    if (fieldDesc.type == RFCTYPE_STRUCTURE || fieldDesc.type == RFCTYPE_TABLE) {
+      field.typePlan = this->CompileType(fieldDesc.typeDescHandle, errorInfo);
+      if (field.typePlan == nullptr) {
+        return nullptr;
+      }
+    }
+  }
+
+  return typePlan;
+}
+
+bool FunctionPlan::Reset(RFC_FUNCTION_HANDLE functionHandle, RFC_ERROR_INFO *errorInfo) const
+{
+  return ResetFields(functionHandle, this->parameters, errorInfo);
+}
+
+/**
+ * Sets every field of a container back to the initial value of its ABAP type
+ */
+bool FunctionPlan::ResetFields(CHND container, const std::vector<FieldPlan> &fields, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  static const SAP_UC initialDate[8] = { cU('0'), cU('0'), cU('0'), cU('0'), cU('0'), cU('0'), cU('0'), cU('0') };
+  static const SAP_UC initialTime[6] = { cU('0'), cU('0'), cU('0'), cU('0'), cU('0'), cU('0') };
+  static const SAP_UC empty[1] = { 0 };
+  static const SAP_RAW none[1] = { 0 };
+
+  for (unsigned int i = 0; i < fields.size(); i++) {
+    const FieldPlan &field = fields[i];
+
+    switch (field.type) {
+      case RFCTYPE_CHAR:
+        rc = RfcSetChars(container, field.name, empty, 0, errorInfo);
+        break;
+      case RFCTYPE_NUM: {
+        std::vector<SAP_UC> zeros(field.nucLength, cU('0'));
+        rc = RfcSetNum(container, field.name, zeros.data(), field.nucLength, errorInfo);
+        break;
+      }
+      case RFCTYPE_DATE:
+        rc = RfcSetDate(container, field.name, initialDate, errorInfo);
+        break;
+      case RFCTYPE_TIME:
+        rc = RfcSetTime(container, field.name, initialTime, errorInfo);
+        break;
+      case RFCTYPE_BCD:
+      case RFCTYPE_DECF16:
+      case RFCTYPE_DECF34:
+        rc = RfcSetString(container, field.name, cU("0"), 1, errorInfo);
+        break;
+      case RFCTYPE_STRING:
+      case RFCTYPE_UTCLONG:
+        rc = RfcSetString(container, field.name, empty, 0, errorInfo);
+        break;
+      case RFCTYPE_BYTE: {
+        std::vector<SAP_RAW> zeros(field.nucLength, 0);
+        rc = RfcSetBytes(container, field.name, zeros.data(), field.nucLength, errorInfo);
+        break;
+      }
+      case RFCTYPE_XSTRING:
+        rc = RfcSetXString(container, field.name, none, 0, errorInfo);
+        break;
+      case RFCTYPE_FLOAT:
+        rc = RfcSetFloat(container, field.name, 0, errorInfo);
+        break;
+      case RFCTYPE_INT:
+        rc = RfcSetInt(container, field.name, 0, errorInfo);
+        break;
+      case RFCTYPE_INT1:
+        rc = RfcSetInt1(container, field.name, 0, errorInfo);
+        break;
+      case RFCTYPE_INT2:
+        rc = RfcSetInt2(container, field.name, 0, errorInfo);
+        break;
+      case RFCTYPE_INT8:
+        rc = RfcSetInt8(container, field.name, 0, errorInfo);
+        break;
+      case RFCTYPE_STRUCTURE: {
+        RFC_STRUCTURE_HANDLE structHandle;
+        rc = RfcGetStructure(container, field.name, &structHandle, errorInfo);
+        if (rc == RFC_OK && !ResetFields(structHandle, field.typePlan->fields, errorInfo)) {
+          return false;
+        }
+        break;
+      }
+      case RFCTYPE_TABLE: {
+        RFC_TABLE_HANDLE tableHandle;
+        rc = RfcGetTable(container, field.name, &tableHandle, errorInfo);
+        if (rc == RFC_OK) {
+          rc = RfcDeleteAllRows(tableHandle, errorInfo);
+        }
+        break;
+      }
+      default:
+        // Not supported by the binding, never written
+        break;
+    }
+
+    if (rc != RFC_OK) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,119 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef FUNCTIONPLAN_H_
+#define FUNCTIONPLAN_H_
+
+#include "Common.h"
+#include <sapnwrfc.h>
+#include <map>
+#include <vector>
+
+class TypePlan;
+
+/**
+ * Flattened description of a function parameter or a structure field.
+ */
+class FieldPlan
+{
+  public:
+  FieldPlan();
+
+  RFC_ABAP_NAME name;
+  RFCTYPE type;
+  RFC_DIRECTION direction;
+  unsigned int nucLength;
+  unsigned int ucLength;
+  unsigned int nucOffset;
+  unsigned int ucOffset;
+  unsigned int decimals;
+
+  // Line type of structures and tables
+  TypePlan *typePlan;
+};
+
+/**
+ * Property keys of a list of fields, created on first use and shared by all
+ * rows. Strings cannot be referenced before N-API 10, so the keys are held
+ * in one referenced array, indexed like the fields.
+ */
+class FieldNames
+{
+  public:
+  explicit FieldNames(const std::vector<FieldPlan> &fields) : fields(fields), env(nullptr), keys(nullptr) { };
+  ~FieldNames();
+
+  // Must be called on the main thread
+  napi_value Get(napi_env env, unsigned int index) const;
+  void Load(napi_env env, std::vector<napi_value> &keys) const;
+
+  private:
+  FieldNames(const FieldNames&);
+  FieldNames& operator=(const FieldNames&);
+
+  napi_value Keys(napi_env env) const;
+
+  const std::vector<FieldPlan> &fields;
+  mutable napi_env env;
+  mutable napi_ref keys;
+};
+
+class TypePlan
+{
+  public:
+  TypePlan() : typeDescHandle(nullptr), names(fields) { };
+
+  RFC_TYPE_DESC_HANDLE typeDescHandle;
+  std::vector<FieldPlan> fields;
+  FieldNames names;
+};
+
+/**
+ * Describes the interface of a function once, so that invocations walk these
+ * arrays instead of querying the SDK for every parameter, structure and row.
+ * Compiling does not touch V8 and may happen on a worker thread.
+ */
+class FunctionPlan
+{
+  public:
+  FunctionPlan();
+  ~FunctionPlan();
+
+  bool Compile(RFC_FUNCTION_DESC_HANDLE functionDescHandle, RFC_ERROR_INFO *errorInfo);
+
+  // Clears all parameters of a function handle, so that it can be reused for the next call
+  bool Reset(RFC_FUNCTION_HANDLE functionHandle, RFC_ERROR_INFO *errorInfo) const;
+
+  std::vector<FieldPlan> parameters;
+  FieldNames names;
+
+  protected:
+  TypePlan* CompileType(RFC_TYPE_DESC_HANDLE typeDescHandle, RFC_ERROR_INFO *errorInfo);
+  static bool ResetFields(CHND container, const std::vector<FieldPlan> &fields, RFC_ERROR_INFO *errorInfo);
+
+  // Every line type is compiled once, even if it is used by several parameters
+  std::map<RFC_TYPE_DESC_HANDLE, TypePlan*> types;
+};
+
+#endif /* FUNCTIONPLAN_H_ */
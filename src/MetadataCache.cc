@@ -0,0 +1,308 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "MetadataCache.h"
+
+std::unordered_map<std::string, MetadataCache::Entry> MetadataCache::entries;
+std::unordered_map<RFC_FUNCTION_DESC_HANDLE, MetadataCache::Usage> MetadataCache::usages;
+std::unordered_map<RFC_FUNCTION_DESC_HANDLE, MetadataCache::Usage> MetadataCache::unused;
+uint64_t MetadataCache::ttl = 0;
+uv_mutex_t MetadataCache::cacheMutex;
+uv_rwlock_t MetadataCache::sdkLock;
+
+static uv_once_t cacheMutexOnce = UV_ONCE_INIT;
+
+// Function names are case insensitive, the cache keeps them in upper case
+static SAP_UC ToUpper(SAP_UC c)
+{
+  return (c >= 'a' && c <= 'z') ? (c - 'a' + 'A') : c;
+}
+
+static bool IsSameName(const SAP_UC *upper, const SAP_UC *name)
+{
+  while (*upper && *upper == ToUpper(*name)) {
+    upper++;
+    name++;
+  }
+
+  return *upper == ToUpper(*name);
+}
+
+void MetadataCache::InitMutex(void)
+{
+  uv_mutex_init(&cacheMutex);
+  uv_rwlock_init(&sdkLock);
+}
+
+void MetadataCache::Init(napi_env env, napi_value exports)
+{
+  uv_once(&cacheMutexOnce, MetadataCache::InitMutex);
+
+  napi_property_descriptor methods[] = {
+    Method("SetTTL", MetadataCache::SetTTL),
+    Method("Invalidate", MetadataCache::Invalidate),
+    Method("Size", MetadataCache::Size)
+  };
+
+  napi_value cache = NewObject(env);
+  napi_define_properties(env, cache, sizeof(methods) / sizeof(methods[0]), methods);
+
+  Set(env, exports, "MetadataCache", cache);
+}
+
+RFC_FUNCTION_DESC_HANDLE MetadataCache::GetFunctionDesc(RFC_CONNECTION_HANDLE connectionHandle, const SAP_UC *functionName, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  RFC_ATTRIBUTES attributes;
+  RFC_FUNCTION_DESC_HANDLE functionDescHandle = nullptr;
+  bool expired = false;
+
+  // Reads locally cached connection data, no round trip involved
+  rc = RfcGetConnectionAttributes(connectionHandle, &attributes, errorInfo);
+  if (rc != RFC_OK) {
+    return nullptr;
+  }
+
+  std::string key = MakeKey(attributes.sysId, functionName);
+  uint64_t now = uv_hrtime() / 1000000;
+
+  uv_mutex_lock(&cacheMutex);
+  std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+  if (it != entries.end()) {
+    if (ttl == 0 || now - it->second.created < ttl) {
+      functionDescHandle = it->second.functionDescHandle;
+      usages[functionDescHandle].refs++;
+    } else {
+      Retire(it->second.functionDescHandle);
+      entries.erase(it);
+      expired = true;
+    }
+  }
+  uv_mutex_unlock(&cacheMutex);
+
+  if (functionDescHandle != nullptr) {
+    memset(errorInfo, 0, sizeof(RFC_ERROR_INFO));
+    return functionDescHandle;
+  }
+
+  if (expired) {
+    // Make the SDK fetch the description from the backend again, unless it is still used
+    RemoveRetired();
+  }
+
+  // Fetched without holding the cache lock, concurrent misses end up with the same SDK handle.
+  // Descriptions are not removed from the SDK before this one has been counted.
+  uv_rwlock_rdlock(&sdkLock);
+
+  functionDescHandle = RfcGetFunctionDesc(connectionHandle, functionName, errorInfo);
+  if (functionDescHandle != nullptr) {
+    uv_mutex_lock(&cacheMutex);
+    // Still known to the SDK if RemoveRetired has been skipped, it is in use again now
+    std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage>::iterator pending = unused.find(functionDescHandle);
+    if (pending != unused.end()) {
+      usages[functionDescHandle] = pending->second;
+      unused.erase(pending);
+    }
+
+    Usage &usage = usages[functionDescHandle];
+    if (usage.refs == 0 && !usage.retired) {
+      memset(usage.sysId, 0, sizeof(usage.sysId));
+      memset(usage.functionName, 0, sizeof(usage.functionName));
+      strncpyU(usage.sysId, attributes.sysId, sizeof(usage.sysId) / sizeof(SAP_UC) - 1);
+      for (size_t i = 0; functionName[i] && i < sizeof(usage.functionName) / sizeof(SAP_UC) - 1; i++) {
+        usage.functionName[i] = ToUpper(functionName[i]);
+      }
+    }
+    usage.refs++;
+
+    // A retired description that is still in use is handed out, but not cached again
+    if (!usage.retired) {
+      Entry entry;
+      entry.functionDescHandle = functionDescHandle;
+      entry.created = now;
+      entries[key] = entry;
+    }
+    uv_mutex_unlock(&cacheMutex);
+  }
+
+  uv_rwlock_rdunlock(&sdkLock);
+
+  return functionDescHandle;
+}
+
+void MetadataCache::Release(RFC_FUNCTION_DESC_HANDLE functionDescHandle)
+{
+  bool retired = false;
+
+  uv_mutex_lock(&cacheMutex);
+  std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage>::iterator it = usages.find(functionDescHandle);
+  if (it != usages.end() && it->second.refs > 0 && --it->second.refs == 0 && it->second.retired) {
+    unused[it->first] = it->second;
+    usages.erase(it);
+    retired = true;
+  }
+  uv_mutex_unlock(&cacheMutex);
+
+  if (retired) {
+    RemoveRetired();
+  }
+}
+
+// Must be called with cacheMutex held
+void MetadataCache::Retire(RFC_FUNCTION_DESC_HANDLE functionDescHandle)
+{
+  std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage>::iterator it = usages.find(functionDescHandle);
+  if (it == usages.end()) {
+    return;
+  }
+
+  if (it->second.refs == 0) {
+    unused[it->first] = it->second;
+    usages.erase(it);
+  } else {
+    it->second.retired = true;
+  }
+}
+
+/**
+ * Removes unused retired descriptions from the SDK. Skipped while a description
+ * is being fetched, the next call takes care of them.
+ */
+void MetadataCache::RemoveRetired(void)
+{
+  std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage> removed;
+  RFC_ERROR_INFO errorInfo;
+
+  if (uv_rwlock_trywrlock(&sdkLock) != 0) {
+    return;
+  }
+
+  uv_mutex_lock(&cacheMutex);
+  removed.swap(unused);
+  uv_mutex_unlock(&cacheMutex);
+
+  for (std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage>::iterator it = removed.begin(); it != removed.end(); ++it) {
+    RfcRemoveFunctionDesc(it->second.sysId, it->second.functionName, &errorInfo);
+  }
+
+  uv_rwlock_wrunlock(&sdkLock);
+}
+
+/**
+ * Drops matching entries, nullptr matches everything. Descriptions still used
+ * by Function objects are removed from the SDK once these have been released.
+ */
+unsigned int MetadataCache::Remove(const SAP_UC *sysId, const SAP_UC *functionName)
+{
+  unsigned int count = 0;
+
+  uv_mutex_lock(&cacheMutex);
+  std::unordered_map<std::string, Entry>::iterator it = entries.begin();
+  while (it != entries.end()) {
+    const Usage &usage = usages[it->second.functionDescHandle];
+    if ((sysId == nullptr || strcmpU(usage.sysId, sysId) == 0) &&
+        (functionName == nullptr || IsSameName(usage.functionName, functionName))) {
+      Retire(it->second.functionDescHandle);
+      it = entries.erase(it);
+      count++;
+    } else {
+      ++it;
+    }
+  }
+  uv_mutex_unlock(&cacheMutex);
+
+  RemoveRetired();
+
+  return count;
+}
+
+std::string MetadataCache::MakeKey(const SAP_UC *sysId, const SAP_UC *functionName)
+{
+  std::string key(reinterpret_cast<const char*>(sysId), strlenU(sysId) * sizeof(SAP_UC));
+  key.push_back('\0');
+
+  for (const SAP_UC *c = functionName; *c; c++) {
+    SAP_UC upper = ToUpper(*c);
+    key.append(reinterpret_cast<const char*>(&upper), sizeof(SAP_UC));
+  }
+
+  return key;
+}
+
+/**
+ * SetTTL(milliseconds), 0 keeps descriptions until they are invalidated
+ */
+NAPI_METHOD(MetadataCache::SetTTL)
+{
+  CallbackInfo info(env, cbinfo);
+
+  if (info.Length() != 1 || !IsUint32(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be a positive number");
+  }
+
+  uv_mutex_lock(&cacheMutex);
+  ttl = Uint32Value(env, info[0]);
+  uv_mutex_unlock(&cacheMutex);
+
+  return Boolean(env, true);
+}
+
+/**
+ * Invalidate([sysId], [functionName])
+ *
+ * @return Number of removed descriptions
+ */
+NAPI_METHOD(MetadataCache::Invalidate)
+{
+  CallbackInfo info(env, cbinfo);
+
+  for (size_t i = 0; i < info.Length() && i < 2; i++) {
+    if (!IsString(env, info[i]) && !IsNull(env, info[i]) && !IsUndefined(env, info[i])) {
+      return ThrowError(env, "Arguments must be strings");
+    }
+  }
+
+  SAP_UC *sysId = IsString(env, info[0]) ? convertToSAPUC(env, info[0]) : nullptr;
+  SAP_UC *functionName = IsString(env, info[1]) ? convertToSAPUC(env, info[1]) : nullptr;
+
+  unsigned int count = Remove(sysId, functionName);
+
+  free(sysId);
+  free(functionName);
+
+  return Uint32(env, count);
+}
+
+/**
+ *
+ * @return Number of cached descriptions
+ */
+NAPI_METHOD(MetadataCache::Size)
+{
+  uv_mutex_lock(&cacheMutex);
+  unsigned int size = entries.size();
+  uv_mutex_unlock(&cacheMutex);
+
+  return Uint32(env, size);
+}
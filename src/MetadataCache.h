@@ -0,0 +1,96 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef METADATACACHE_H_
+#define METADATACACHE_H_
+
+#include "Common.h"
+#include <uv.h>
+#include <sapnwrfc.h>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Process wide cache of function descriptions, keyed by system ID and
+ * function name. All members are thread safe.
+ *
+ * Every description handed out is counted until it is released. Expired or
+ * invalidated descriptions are only removed from the SDK once they are no
+ * longer used, so that Function objects looked up before stay valid.
+ */
+class MetadataCache
+{
+  public:
+
+    static void Init(napi_env env, napi_value exports);
+
+    // The description must be released once it is no longer used
+    static RFC_FUNCTION_DESC_HANDLE GetFunctionDesc(RFC_CONNECTION_HANDLE connectionHandle, const SAP_UC *functionName, RFC_ERROR_INFO *errorInfo);
+    static void Release(RFC_FUNCTION_DESC_HANDLE functionDescHandle);
+    static unsigned int Remove(const SAP_UC *sysId, const SAP_UC *functionName);
+
+  protected:
+
+    static NAPI_METHOD(SetTTL);
+    static NAPI_METHOD(Invalidate);
+    static NAPI_METHOD(Size);
+
+    static void InitMutex(void);
+    static std::string MakeKey(const SAP_UC *sysId, const SAP_UC *functionName);
+
+    class Entry
+    {
+      public:
+      RFC_FUNCTION_DESC_HANDLE functionDescHandle;
+      uint64_t created;
+    };
+
+    class Usage
+    {
+      public:
+      Usage() : refs(0), retired(false) { };
+
+      unsigned int refs;
+      // No longer cached, removed from the SDK once unused
+      bool retired;
+      SAP_UC sysId[8 + 1];
+      RFC_ABAP_NAME functionName;
+    };
+
+    // Must be called with cacheMutex held
+    static void Retire(RFC_FUNCTION_DESC_HANDLE functionDescHandle);
+    // Must be called without holding cacheMutex
+    static void RemoveRetired(void);
+
+    static std::unordered_map<std::string, Entry> entries;
+    static std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage> usages;
+    // Retired and unused, waiting for RemoveRetired
+    static std::unordered_map<RFC_FUNCTION_DESC_HANDLE, Usage> unused;
+    static uint64_t ttl;
+    static uv_mutex_t cacheMutex;
+    // Held shared while the SDK is asked for a description, exclusively while removing some
+    static uv_rwlock_t sdkLock;
+};
+
+#endif /* METADATACACHE_H_ */
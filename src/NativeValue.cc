@@ -0,0 +1,740 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "NativeValue.h"
+#include "ColumnarTable.h"
+#include <cassert>
+#include <stdlib.h>
+
+// Scientific notation of the longest DECFLOAT34 value
+#define DECFLOAT_MAX_LENGTH 42
+// ISO 8601 representation of a UTCLONG, e.g. 2020-01-31T23:59:59,1234567
+#define UTCLONG_MAX_LENGTH 32
+
+bool NativeValue::Decode(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+
+  switch (field.type) {
+    case RFCTYPE_DATE:
+    case RFCTYPE_TIME:
+    case RFCTYPE_NUM:
+    case RFCTYPE_CHAR:
+      return this->DecodeChars(container, field, options, arena, errorInfo);
+    case RFCTYPE_BCD:
+    case RFCTYPE_DECF16:
+    case RFCTYPE_DECF34:
+      return this->DecodeDecimal(container, field, options, arena, errorInfo);
+    case RFCTYPE_BYTE:
+      this->bytes = static_cast<SAP_RAW*>(malloc(field.nucLength > 0 ? field.nucLength : 1));
+      assert(this->bytes);
+      this->kind = VALUE_BUFFER;
+      this->length = field.nucLength;
+      rc = RfcGetBytes(container, field.name, this->bytes, field.nucLength, errorInfo);
+      break;
+    case RFCTYPE_FLOAT:
+      this->kind = VALUE_NUMBER;
+      rc = RfcGetFloat(container, field.name, &this->number, errorInfo);
+      break;
+    case RFCTYPE_INT: {
+      RFC_INT value = 0;
+      rc = RfcGetInt(container, field.name, &value, errorInfo);
+      this->kind = VALUE_INTEGER;
+      this->integer = value;
+      break;
+    }
+    case RFCTYPE_INT1: {
+      RFC_INT1 value = 0;
+      rc = RfcGetInt1(container, field.name, &value, errorInfo);
+      this->kind = VALUE_INTEGER;
+      this->integer = value;
+      break;
+    }
+    case RFCTYPE_INT2: {
+      RFC_INT2 value = 0;
+      rc = RfcGetInt2(container, field.name, &value, errorInfo);
+      this->kind = VALUE_INTEGER;
+      this->integer = value;
+      break;
+    }
+    case RFCTYPE_INT8: {
+      RFC_INT8 value = 0;
+      rc = RfcGetInt8(container, field.name, &value, errorInfo);
+      if (options.int8AsBigInt) {
+        this->kind = VALUE_INT64;
+        this->integer64 = value;
+      } else {
+        // Exact up to 2^53
+        this->kind = VALUE_NUMBER;
+        this->number = static_cast<double>(value);
+      }
+      break;
+    }
+    case RFCTYPE_UTCLONG: {
+      unsigned retStrLen;
+      this->kind = VALUE_STRING;
+      this->string = static_cast<SAP_UC*>(arena.Allocate((UTCLONG_MAX_LENGTH + 1) * sizeof(SAP_UC)));
+      rc = RfcGetString(container, field.name, this->string, UTCLONG_MAX_LENGTH + 1, &retStrLen, errorInfo);
+      if (rc != RFC_OK) {
+        return false;
+      }
+      this->length = retStrLen;
+      this->Narrow(options);
+      break;
+    }
+    case RFCTYPE_STRUCTURE: {
+      RFC_STRUCTURE_HANDLE strucHandle;
+      rc = RfcGetStructure(container, field.name, &strucHandle, errorInfo);
+      if (rc != RFC_OK) {
+        return false;
+      }
+      assert(field.typePlan);
+      this->kind = VALUE_STRUCTURE;
+      this->structure = new NativeStructure(*field.typePlan, arena, options);
+      return this->structure->Decode(strucHandle, errorInfo);
+    }
+    case RFCTYPE_TABLE: {
+      RFC_TABLE_HANDLE tableHandle;
+      unsigned int rowCount;
+      rc = RfcGetTable(container, field.name, &tableHandle, errorInfo);
+      if (rc != RFC_OK) {
+        return false;
+      }
+      rc = RfcGetRowCount(tableHandle, &rowCount, errorInfo);
+      if (rc != RFC_OK) {
+        return false;
+      }
+      assert(field.typePlan);
+      this->kind = VALUE_TABLE;
+      this->table = new NativeTable(*field.typePlan, arena, options);
+      return this->table->Decode(tableHandle, 0, rowCount, errorInfo);
+    }
+    case RFCTYPE_STRING:
+      return this->DecodeString(container, field, options, arena, errorInfo);
+    case RFCTYPE_XSTRING:
+      return this->DecodeXString(container, field, options, arena, errorInfo);
+    default:
+      // Type not implemented, reported when converting
+      this->kind = VALUE_UNSUPPORTED;
+      this->type = field.type;
+      break;
+  }
+
+  return rc == RFC_OK;
+}
+
+bool NativeValue::DecodeChars(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  unsigned int len = field.nucLength;
+
+  if (field.type == RFCTYPE_DATE) {
+    len = sizeof(RFC_DATE) / sizeof(RFC_CHAR);
+  } else if (field.type == RFCTYPE_TIME) {
+    len = sizeof(RFC_TIME) / sizeof(RFC_CHAR);
+  }
+
+  // The getters fill all len characters, only the terminator is set here
+  this->string = static_cast<SAP_UC*>(arena.Allocate((len + 1) * sizeof(SAP_UC)));
+  this->string[len] = 0;
+  this->kind = VALUE_STRING;
+
+  switch (field.type) {
+    case RFCTYPE_DATE:
+      rc = RfcGetDate(container, field.name, this->string, errorInfo);
+      this->length = len;
+      break;
+    case RFCTYPE_TIME:
+      rc = RfcGetTime(container, field.name, this->string, errorInfo);
+      this->length = len;
+      break;
+    case RFCTYPE_NUM:
+      rc = RfcGetNum(container, field.name, this->string, len, errorInfo);
+      this->length = strlenU(this->string);
+      break;
+    default:
+      rc = RfcGetChars(container, field.name, this->string, len, errorInfo);
+      this->length = strlenU(this->string);
+      break;
+  }
+
+  if (rc != RFC_OK) {
+    return false;
+  }
+  if (options.rtrim && (field.type == RFCTYPE_CHAR || field.type == RFCTYPE_NUM)) {
+    this->length = Unicode::TrimmedLength(this->string, this->length);
+  }
+  this->Narrow(options);
+
+  return true;
+}
+
+bool NativeValue::DecodeString(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  unsigned strLen, retStrLen;
+
+  this->kind = VALUE_STRING;
+  this->string = nullptr;
+  this->length = 0;
+
+  rc = RfcGetStringLength(container, field.name, &strLen, errorInfo);
+  if (rc != RFC_OK) {
+    return false;
+  }
+
+  if (strLen == 0) {
+    this->Narrow(options);
+    return true;
+  }
+
+  this->string = static_cast<SAP_UC*>(arena.Allocate((strLen + 1) * sizeof(SAP_UC)));
+
+  rc = RfcGetString(container, field.name, this->string, strLen + 1, &retStrLen, errorInfo);
+  if (rc != RFC_OK) {
+    return false;
+  }
+  this->length = retStrLen;
+  this->Narrow(options);
+
+  return true;
+}
+
+bool NativeValue::DecodeXString(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  unsigned strLen, retStrLen;
+
+  rc = RfcGetStringLength(container, field.name, &strLen, errorInfo);
+  if (rc != RFC_OK) {
+    return false;
+  }
+
+  // Empty XSTRINGs have always been returned as empty strings
+  if (strLen == 0) {
+    this->kind = VALUE_STRING;
+    this->string = nullptr;
+    this->length = 0;
+    this->Narrow(options);
+    return true;
+  }
+
+  // Filled in place and handed over to Node as is, see ToJS
+  this->bytes = static_cast<SAP_RAW*>(malloc(strLen * sizeof(SAP_RAW)));
+  assert(this->bytes);
+  this->kind = VALUE_BUFFER;
+  this->length = strLen;
+
+  rc = RfcGetXString(container, field.name, this->bytes, strLen, &retStrLen, errorInfo);
+
+  return rc == RFC_OK;
+}
+
+/**
+ * Parses a decimal string into the words of value * 10^decimals, fails on
+ * values that do not fit into 128 bits or have more decimals
+ */
+static bool ParseScaled(const SAP_UC *str, unsigned int length, unsigned int decimals, uint64_t *words)
+{
+  uint32_t limbs[4] = { 0, 0, 0, 0 };
+  bool negative = false;
+  int fraction = -1;
+
+  for (unsigned int i = 0; i < length + decimals; i++) {
+    unsigned int digit;
+
+    if (i >= length) {
+      // Pad to the scale of the field
+      if (fraction < 0) {
+        fraction = 0;
+      }
+      if (fraction >= static_cast<int>(decimals)) {
+        break;
+      }
+      digit = 0;
+    } else if (str[i] == cU('-')) {
+      negative = true;
+      continue;
+    } else if (str[i] == cU('.')) {
+      fraction = 0;
+      continue;
+    } else if (str[i] == cU(' ') || str[i] == cU('+')) {
+      continue;
+    } else if (str[i] >= cU('0') && str[i] <= cU('9')) {
+      digit = str[i] - cU('0');
+    } else {
+      return false;
+    }
+
+    uint64_t carry = digit;
+    for (unsigned int j = 0; j < 4; j++) {
+      uint64_t product = static_cast<uint64_t>(limbs[j]) * 10 + carry;
+      limbs[j] = static_cast<uint32_t>(product);
+      carry = product >> 32;
+    }
+    if (carry != 0) {
+      return false;
+    }
+    if (fraction >= 0 && ++fraction > static_cast<int>(decimals)) {
+      return false;
+    }
+  }
+
+  words[0] = negative ? 1 : 0;
+  words[1] = limbs[0] | (static_cast<uint64_t>(limbs[1]) << 32);
+  words[2] = limbs[2] | (static_cast<uint64_t>(limbs[3]) << 32);
+
+  return true;
+}
+
+/**
+ * Converts BCD and DECFLOAT values from their exact string representation,
+ * numbers are parsed here instead of on the main thread
+ */
+bool NativeValue::DecodeDecimal(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  // Sign, decimal point and up to 31 digits of a packed number
+  unsigned strLen = field.type == RFCTYPE_BCD ? 2 * field.nucLength + 1 : DECFLOAT_MAX_LENGTH;
+  unsigned retStrLen;
+
+  SAP_UC *str = static_cast<SAP_UC*>(arena.Allocate((strLen + 1) * sizeof(SAP_UC)));
+  rc = RfcGetString(container, field.name, str, strLen + 1, &retStrLen, errorInfo);
+  if (rc == RFC_BUFFER_TOO_SMALL) {
+    // Retry with suggested string length
+    strLen = retStrLen;
+    str = static_cast<SAP_UC*>(arena.Allocate((strLen + 1) * sizeof(SAP_UC)));
+    rc = RfcGetString(container, field.name, str, strLen + 1, &retStrLen, errorInfo);
+  }
+  if (rc != RFC_OK) {
+    return false;
+  }
+
+  if (options.decimals == DecodeOptions::DECIMALS_BIGINT && field.type == RFCTYPE_BCD) {
+    uint64_t *words = static_cast<uint64_t*>(arena.Allocate(3 * sizeof(uint64_t)));
+    if (ParseScaled(str, retStrLen, field.decimals, words)) {
+      this->kind = VALUE_BIGINT;
+      this->words = words;
+      return true;
+    }
+  }
+
+  if (options.decimals != DecodeOptions::DECIMALS_NUMBER) {
+    // DECFLOATs have no fixed scale and are returned as strings in bigint mode
+    this->kind = VALUE_STRING;
+    this->string = str;
+    this->length = retStrLen;
+    this->Narrow(options);
+    return true;
+  }
+
+  // Decimal strings only consist of ASCII characters
+  char *ascii = static_cast<char*>(arena.Allocate(retStrLen + 1));
+  for (unsigned int i = 0; i < retStrLen; i++) {
+    ascii[i] = static_cast<char>(str[i]);
+  }
+  ascii[retStrLen] = '\0';
+
+  this->kind = VALUE_NUMBER;
+  this->number = strtod(ascii, nullptr);
+
+  return true;
+}
+
+/**
+ * Stores strings that fit into one byte per character as such, in place.
+ * V8 would check and copy them on the main thread otherwise. Empty strings
+ * are dropped if requested.
+ */
+void NativeValue::Narrow(const DecodeOptions &options)
+{
+  if (this->length == 0 && options.skipEmpty) {
+    this->Free();
+  } else if (this->length > 0 && Unicode::IsLatin1(this->string, this->length)) {
+    Unicode::ToLatin1(this->string, this->length, this->latin1);
+    this->kind = VALUE_LATIN1;
+  }
+}
+
+napi_value NativeValue::ToJS(napi_env env)
+{
+  napi_value value = Null(env);
+
+  switch (this->kind) {
+    case VALUE_NULL:
+      break;
+    case VALUE_NUMBER:
+      value = Number(env, this->number);
+      break;
+    case VALUE_INTEGER:
+      value = Int32(env, this->integer);
+      break;
+    case VALUE_INT64:
+      napi_create_bigint_int64(env, this->integer64, &value);
+      break;
+    case VALUE_BIGINT:
+      napi_create_bigint_words(env, static_cast<int>(this->words[0]), 2, this->words + 1, &value);
+      break;
+    case VALUE_STRING:
+      value = NewString(env, this->string, this->length);
+      break;
+    case VALUE_LATIN1:
+      napi_create_string_latin1(env, reinterpret_cast<const char*>(this->latin1), this->length, &value);
+      break;
+    case VALUE_BUFFER:
+      // The buffer takes over the memory
+      value = TakeBuffer(env, reinterpret_cast<char*>(this->bytes), this->length);
+      this->bytes = nullptr;
+      this->kind = VALUE_NULL;
+      break;
+    case VALUE_EXTERNAL:
+      // Input only
+      break;
+    case VALUE_STRUCTURE:
+      value = this->structure->ToJS(env);
+      break;
+    case VALUE_TABLE:
+      value = this->table->ToJS(env);
+      break;
+    case VALUE_COLUMNS:
+      value = this->columns->ToJS(env);
+      break;
+    case VALUE_UNSUPPORTED:
+      RETURN_RFC_ERROR("RFC type not implemented: ", Uint32(env, this->type));
+  }
+
+  return value;
+}
+
+void NativeValue::CopyString(napi_env env, napi_value value, Arena &arena)
+{
+  size_t length = 0;
+  napi_get_value_string_utf16(env, value, nullptr, 0, &length);
+
+  this->kind = VALUE_STRING;
+  this->length = length;
+  this->string = static_cast<SAP_UC*>(arena.Allocate((this->length + 1) * sizeof(SAP_UC)));
+
+  napi_get_value_string_utf16(env, value, reinterpret_cast<char16_t*>(this->string), length + 1, &length);
+}
+
+/**
+ * Copies length bytes into a buffer of size bytes, padding with zeros
+ */
+void NativeValue::CopyBytes(const char *data, unsigned int length, unsigned int size)
+{
+  assert(length <= size);
+
+  this->kind = VALUE_BUFFER;
+  this->length = size;
+  this->bytes = static_cast<SAP_RAW*>(malloc(size > 0 ? size : 1));
+  assert(this->bytes);
+
+  memcpy(this->bytes, data, length);
+  memset(this->bytes + length, 0, size - length);
+}
+
+/**
+ * Refers to memory owned by someone else, which must outlive the value
+ */
+void NativeValue::ReferBytes(const char *data, unsigned int length)
+{
+  this->kind = VALUE_EXTERNAL;
+  this->length = length;
+  this->bytes = reinterpret_cast<SAP_RAW*>(const_cast<char*>(data));
+}
+
+bool NativeValue::Encode(const CHND container, const FieldPlan &field, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+
+  switch (field.type) {
+    case RFCTYPE_DATE:
+      rc = RfcSetDate(container, field.name, this->string, errorInfo);
+      break;
+    case RFCTYPE_TIME:
+      rc = RfcSetTime(container, field.name, this->string, errorInfo);
+      break;
+    case RFCTYPE_NUM:
+      rc = RfcSetNum(container, field.name, this->string, this->length, errorInfo);
+      break;
+    case RFCTYPE_CHAR:
+      rc = RfcSetChars(container, field.name, this->string, this->length, errorInfo);
+      break;
+    case RFCTYPE_BCD:
+    case RFCTYPE_DECF16:
+    case RFCTYPE_DECF34:
+    case RFCTYPE_STRING:
+    case RFCTYPE_UTCLONG:
+      rc = RfcSetString(container, field.name, this->string, this->length, errorInfo);
+      break;
+    case RFCTYPE_BYTE:
+      rc = RfcSetBytes(container, field.name, this->bytes, this->length, errorInfo);
+      break;
+    case RFCTYPE_XSTRING:
+      rc = RfcSetXString(container, field.name, this->bytes, this->length, errorInfo);
+      break;
+    case RFCTYPE_FLOAT:
+      rc = RfcSetFloat(container, field.name, this->number, errorInfo);
+      break;
+    case RFCTYPE_INT:
+      rc = RfcSetInt(container, field.name, this->integer, errorInfo);
+      break;
+    case RFCTYPE_INT1:
+      rc = RfcSetInt1(container, field.name, static_cast<RFC_INT1>(this->integer), errorInfo);
+      break;
+    case RFCTYPE_INT2:
+      rc = RfcSetInt2(container, field.name, static_cast<RFC_INT2>(this->integer), errorInfo);
+      break;
+    case RFCTYPE_INT8:
+      rc = RfcSetInt8(container, field.name, this->integer64, errorInfo);
+      break;
+    case RFCTYPE_STRUCTURE: {
+      RFC_STRUCTURE_HANDLE strucHandle;
+      rc = RfcGetStructure(container, field.name, &strucHandle, errorInfo);
+      if (rc != RFC_OK) {
+        return false;
+      }
+      return this->structure->Encode(strucHandle, errorInfo);
+    }
+    case RFCTYPE_TABLE: {
+      RFC_TABLE_HANDLE tableHandle;
+      rc = RfcGetTable(container, field.name, &tableHandle, errorInfo);
+      if (rc != RFC_OK) {
+        return false;
+      }
+      return this->table->Encode(tableHandle, errorInfo);
+    }
+    default:
+      // Rejected when taking the snapshot
+      assert(0);
+      break;
+  }
+
+  return rc == RFC_OK;
+}
+
+void NativeValue::Free(void)
+{
+  switch (this->kind) {
+    case VALUE_BUFFER:
+      free(this->bytes);
+      break;
+    case VALUE_STRUCTURE:
+      delete this->structure;
+      break;
+    case VALUE_TABLE:
+      delete this->table;
+      break;
+    case VALUE_COLUMNS:
+      delete this->columns;
+      break;
+    default:
+      break;
+  }
+
+  this->kind = VALUE_NULL;
+  this->length = 0;
+  this->number = 0;
+}
+
+InputStorage::~InputStorage()
+{
+  if (this->buffers != nullptr) {
+    napi_delete_reference(this->env, this->buffers);
+  }
+}
+
+void InputStorage::Pin(napi_env env, NativeValue &target, napi_value buffer)
+{
+  if (this->buffers == nullptr) {
+    this->env = env;
+    napi_create_reference(env, NewArray(env), 1, &this->buffers);
+  }
+  Set(env, Reference(env, this->buffers), this->count++, buffer);
+
+  void *data = nullptr;
+  size_t length = 0;
+  napi_get_buffer_info(env, buffer, &data, &length);
+  target.ReferBytes(static_cast<const char*>(data), length);
+}
+
+NativeStructure::~NativeStructure()
+{
+  for (unsigned int i = 0; i < this->fields.size(); i++) {
+    this->fields[i].Free();
+  }
+}
+
+bool NativeStructure::Decode(RFC_STRUCTURE_HANDLE strucHandle, RFC_ERROR_INFO *errorInfo)
+{
+  this->fields.resize(this->typePlan.fields.size());
+
+  for (unsigned int i = 0; i < this->typePlan.fields.size(); i++) {
+    if (!this->fields[i].Decode(strucHandle, this->typePlan.fields[i], this->options, this->arena, errorInfo)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool NativeStructure::Encode(RFC_STRUCTURE_HANDLE strucHandle, RFC_ERROR_INFO *errorInfo)
+{
+  for (unsigned int i = 0; i < this->fields.size(); i++) {
+    if (this->fields[i].kind != NativeValue::VALUE_NULL &&
+        !this->fields[i].Encode(strucHandle, this->typePlan.fields[i], errorInfo)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Creates a row with one napi_define_properties call. The fields are always
+ * defined in the same order, so that complete rows of one type share one map.
+ */
+static napi_value NewRow(napi_env env, const std::vector<napi_value> &keys, NativeValue *cells, bool skipEmpty,
+                         std::vector<napi_property_descriptor> &properties)
+{
+  properties.clear();
+
+  for (unsigned int i = 0; i < keys.size(); i++) {
+    if (skipEmpty && cells[i].kind == NativeValue::VALUE_NULL) {
+      continue;
+    }
+    napi_value value = cells[i].ToJS(env);
+    // Bail out on exception
+    if (IsException(env, value)) {
+      return value;
+    }
+
+    napi_property_descriptor property = { nullptr, keys[i], nullptr, nullptr, nullptr, value,
+      static_cast<napi_property_attributes>(napi_writable | napi_enumerable | napi_configurable), nullptr };
+    properties.push_back(property);
+  }
+
+  napi_value row = NewObject(env);
+  napi_define_properties(env, row, properties.size(), properties.data());
+
+  return row;
+}
+
+napi_value NativeStructure::ToJS(napi_env env)
+{
+  std::vector<napi_value> keys;
+  std::vector<napi_property_descriptor> properties;
+
+  this->typePlan.names.Load(env, keys);
+
+  return NewRow(env, keys, this->fields.data(), this->options.skipEmpty, properties);
+}
+
+NativeTable::~NativeTable()
+{
+  for (unsigned int i = 0; i < this->cells.size(); i++) {
+    this->cells[i].Free();
+  }
+}
+
+bool NativeTable::Decode(RFC_TABLE_HANDLE tableHandle, unsigned int start, unsigned int count, RFC_ERROR_INFO *errorInfo)
+{
+  RFC_RC rc = RFC_OK;
+  const unsigned int fieldCount = this->typePlan.fields.size();
+
+  this->Resize(count);
+
+  for (unsigned int r = 0; r < count; r++) {
+    rc = RfcMoveTo(tableHandle, start + r, errorInfo);
+    if (rc != RFC_OK) {
+      return false;
+    }
+    RFC_STRUCTURE_HANDLE strucHandle = RfcGetCurrentRow(tableHandle, errorInfo);
+    if (strucHandle == nullptr) {
+      return false;
+    }
+
+    for (unsigned int i = 0; i < fieldCount; i++) {
+      if (!this->cells[(size_t)r * fieldCount + i].Decode(strucHandle, this->typePlan.fields[i], this->options, this->arena, errorInfo)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+napi_value NativeTable::ToJS(napi_env env)
+{
+  const unsigned int fieldCount = this->typePlan.fields.size();
+
+  std::vector<napi_value> keys;
+  std::vector<napi_property_descriptor> properties;
+
+  // Fetched once for all rows
+  this->typePlan.names.Load(env, keys);
+
+  // Create array holding table lines
+  napi_value obj = NewArray(env, this->rowCount);
+
+  for (unsigned int r = 0; r < this->rowCount; r++) {
+    napi_value line = NewRow(env, keys, this->cells.data() + (size_t)r * fieldCount, this->options.skipEmpty, properties);
+    // Bail out on exception
+    if (IsException(env, line)) {
+      return line;
+    }
+    Set(env, obj, r, line);
+  }
+
+  return obj;
+}
+
+void NativeTable::Resize(unsigned int rowCount)
+{
+  this->rowCount = rowCount;
+  this->cells.resize((size_t)rowCount * this->typePlan.fields.size());
+}
+
+bool NativeTable::Encode(RFC_TABLE_HANDLE tableHandle, RFC_ERROR_INFO *errorInfo)
+{
+  const unsigned int fieldCount = this->typePlan.fields.size();
+
+  for (unsigned int r = 0; r < this->rowCount; r++) {
+    RFC_STRUCTURE_HANDLE strucHandle = RfcAppendNewRow(tableHandle, errorInfo);
+    if (strucHandle == nullptr) {
+      return false;
+    }
+
+    for (unsigned int i = 0; i < fieldCount; i++) {
+      NativeValue &cell = this->cells[(size_t)r * fieldCount + i];
+      if (cell.kind != NativeValue::VALUE_NULL &&
+          !cell.Encode(strucHandle, this->typePlan.fields[i], errorInfo)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,189 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef NATIVEVALUE_H_
+#define NATIVEVALUE_H_
+
+#include "Common.h"
+#include <sapnwrfc.h>
+#include <vector>
+#include "Arena.h"
+#include "FunctionPlan.h"
+
+class NativeStructure;
+class NativeTable;
+class ColumnarTable;
+
+/**
+ * Conversion options of results, set per invocation
+ */
+class DecodeOptions
+{
+  public:
+  enum DecimalMode {
+    DECIMALS_NUMBER,
+    DECIMALS_STRING,
+    DECIMALS_BIGINT
+  };
+
+  DecodeOptions() : rtrim(false), skipEmpty(false), decimals(DECIMALS_NUMBER), int8AsBigInt(false) { };
+
+  // Strip the blanks padding CHAR and NUM values
+  bool rtrim;
+  // Leave empty strings out of the result
+  bool skipEmpty;
+  // Representation of BCD and DECFLOAT values
+  DecimalMode decimals;
+  // Return INT8 values as BigInts instead of numbers
+  bool int8AsBigInt;
+};
+
+/**
+ * Native copy of a single parameter or field value, so that the function
+ * handle is only accessed on the worker thread. Results are read by Decode
+ * and converted by ToJS, input values are snapshotted on the main thread
+ * and written by Encode. Values are plain data, the owning container calls
+ * Free. Strings live in the arena of the invocation and are not freed one by
+ * one. Empty (VALUE_NULL) input values are not written. VALUE_EXTERNAL input
+ * values point into a Node buffer pinned by InputStorage.
+ */
+class NativeValue
+{
+  public:
+  enum Kind {
+    VALUE_NULL,
+    VALUE_NUMBER,
+    VALUE_INTEGER,
+    VALUE_INT64,
+    VALUE_BIGINT,
+    VALUE_STRING,
+    VALUE_LATIN1,
+    VALUE_BUFFER,
+    VALUE_EXTERNAL,
+    VALUE_STRUCTURE,
+    VALUE_TABLE,
+    VALUE_COLUMNS,
+    VALUE_UNSUPPORTED
+  };
+
+  NativeValue() : kind(VALUE_NULL), length(0), number(0) { };
+
+  bool Decode(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo);
+  // Hands buffers over to JavaScript, must be called at most once
+  napi_value ToJS(napi_env env);
+
+  void CopyString(napi_env env, napi_value value, Arena &arena);
+  void CopyBytes(const char *data, unsigned int length, unsigned int size);
+  void ReferBytes(const char *data, unsigned int length);
+  bool Encode(const CHND container, const FieldPlan &field, RFC_ERROR_INFO *errorInfo);
+
+  void Free(void);
+
+  Kind kind;
+  unsigned int length;
+  union {
+    double number;
+    int32_t integer;
+    int64_t integer64;
+    RFCTYPE type;
+    SAP_UC *string;
+    uint8_t *latin1;
+    SAP_RAW *bytes;
+    // Sign and two words of magnitude, least significant first
+    uint64_t *words;
+    NativeStructure *structure;
+    NativeTable *table;
+    ColumnarTable *columns;
+  };
+
+  protected:
+  bool DecodeChars(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo);
+  bool DecodeString(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo);
+  bool DecodeXString(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo);
+  bool DecodeDecimal(const CHND container, const FieldPlan &field, const DecodeOptions &options, Arena &arena, RFC_ERROR_INFO *errorInfo);
+  void Narrow(const DecodeOptions &options);
+};
+
+/**
+ * Owns what the input snapshot of an invocation refers to: the arena holding
+ * copied strings, and the Node buffers that the worker thread hands to the
+ * SDK without copying. Must be created and destroyed on the main thread.
+ */
+class InputStorage
+{
+  public:
+  InputStorage() : env(nullptr), buffers(nullptr), count(0) { };
+  ~InputStorage();
+
+  void Pin(napi_env env, NativeValue &target, napi_value buffer);
+
+  Arena arena;
+
+  protected:
+  napi_env env;
+  // Array of the pinned buffers
+  napi_ref buffers;
+  uint32_t count;
+};
+
+class NativeStructure
+{
+  public:
+  NativeStructure(const TypePlan &typePlan, Arena &arena, const DecodeOptions &options = DecodeOptions()) :
+    typePlan(typePlan), arena(arena), options(options) { };
+  ~NativeStructure();
+
+  bool Decode(RFC_STRUCTURE_HANDLE strucHandle, RFC_ERROR_INFO *errorInfo);
+  napi_value ToJS(napi_env env);
+  bool Encode(RFC_STRUCTURE_HANDLE strucHandle, RFC_ERROR_INFO *errorInfo);
+
+  const TypePlan &typePlan;
+  Arena &arena;
+  const DecodeOptions options;
+  std::vector<NativeValue> fields;
+};
+
+/**
+ * Rows of a table, stored as one flat array of cells
+ */
+class NativeTable
+{
+  public:
+  NativeTable(const TypePlan &typePlan, Arena &arena, const DecodeOptions &options = DecodeOptions()) :
+    typePlan(typePlan), arena(arena), options(options), rowCount(0) { };
+  ~NativeTable();
+
+  bool Decode(RFC_TABLE_HANDLE tableHandle, unsigned int start, unsigned int count, RFC_ERROR_INFO *errorInfo);
+  napi_value ToJS(napi_env env);
+  void Resize(unsigned int rowCount);
+  bool Encode(RFC_TABLE_HANDLE tableHandle, RFC_ERROR_INFO *errorInfo);
+
+  const TypePlan &typePlan;
+  Arena &arena;
+  const DecodeOptions options;
+  unsigned int rowCount;
+  std::vector<NativeValue> cells;
+};
+
+#endif /* NATIVEVALUE_H_ */
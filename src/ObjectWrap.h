@@ -0,0 +1,99 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+
+#ifndef OBJECTWRAP_H_
+#define OBJECTWRAP_H_
+
+#include <node_api.h>
+
+/**
+ * Ties a native object to its JavaScript object, like node::ObjectWrap. The
+ * native object is deleted once the JavaScript object has been collected,
+ * which Ref keeps from happening until the matching Unref.
+ */
+class ObjectWrap
+{
+  public:
+  ObjectWrap() : env(nullptr), wrapper(nullptr) { };
+
+  virtual ~ObjectWrap()
+  {
+    if (this->wrapper != nullptr) {
+      napi_remove_wrap(this->env, this->handle(), nullptr);
+      napi_delete_reference(this->env, this->wrapper);
+    }
+  };
+
+  template <class T>
+  static T* Unwrap(napi_env env, napi_value object)
+  {
+    void *native = nullptr;
+    napi_unwrap(env, object, &native);
+    return static_cast<T*>(static_cast<ObjectWrap*>(native));
+  };
+
+  napi_value handle()
+  {
+    napi_value object = nullptr;
+    napi_get_reference_value(this->env, this->wrapper, &object);
+    return object;
+  };
+
+  napi_env env;
+
+  protected:
+  void Wrap(napi_env env, napi_value object)
+  {
+    this->env = env;
+    napi_wrap(env, object, static_cast<ObjectWrap*>(this), Finalize, nullptr, &this->wrapper);
+  };
+
+  void Ref()
+  {
+    uint32_t refs;
+    napi_reference_ref(this->env, this->wrapper, &refs);
+  };
+
+  void Unref()
+  {
+    uint32_t refs;
+    napi_reference_unref(this->env, this->wrapper, &refs);
+  };
+
+  private:
+  static void Finalize(napi_env env, void *data, void *hint)
+  {
+    ObjectWrap *wrap = static_cast<ObjectWrap*>(data);
+
+    // The object is gone already
+    napi_delete_reference(env, wrap->wrapper);
+    wrap->wrapper = nullptr;
+    delete wrap;
+  };
+
+  napi_ref wrapper;
+};
+
+#endif /* OBJECTWRAP_H_ */
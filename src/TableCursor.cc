@@ -0,0 +1,191 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "TableCursor.h"
+#include "Function.h"
+#include "AddonState.h"
+#include "NativeValue.h"
+#include <cassert>
+
+
+TableCursor::TableCursor() :
+  functionObject(nullptr),
+  sharedHandle(nullptr),
+  tableHandle(nullptr),
+  typePlan(nullptr),
+  rowCount(0),
+  position(0),
+  batchSize(0)
+{
+}
+
+TableCursor::~TableCursor()
+{
+  this->Release();
+}
+
+void TableCursor::Init(napi_env env, napi_value exports)
+{
+  napi_property_descriptor methods[] = {
+    Method("Next", Next),
+    Method("RowCount", RowCount),
+    Method("Close", Close)
+  };
+
+  napi_value ctor;
+  napi_define_class(env, "TableCursor", NAPI_AUTO_LENGTH, New, nullptr,
+                    sizeof(methods) / sizeof(methods[0]), methods, &ctor);
+
+  napi_create_reference(env, ctor, 1, &AddonState::Current()->tableCursorCtor);
+  Set(env, exports, "TableCursor", ctor);
+}
+
+napi_value TableCursor::NewInstance(Function *function, SharedFunctionHandle *sharedHandle,
+                                    const FieldPlan &field, unsigned int batchSize,
+                                    const DecodeOptions &options)
+{
+  napi_env env = function->env;
+  RFC_RC rc = RFC_OK;
+  RFC_ERROR_INFO errorInfo;
+  RFC_TABLE_HANDLE tableHandle;
+  unsigned int rowCount;
+
+  rc = RfcGetTable(sharedHandle->functionHandle, field.name, &tableHandle, &errorInfo);
+  if (rc != RFC_OK) {
+    RETURN_RFC_ERROR(errorInfo);
+  }
+
+  rc = RfcGetRowCount(tableHandle, &rowCount, &errorInfo);
+  if (rc != RFC_OK) {
+    RETURN_RFC_ERROR(errorInfo);
+  }
+
+  napi_value cursor;
+  napi_new_instance(env, Reference(env, AddonState::Current()->tableCursorCtor), 0, nullptr, &cursor);
+  TableCursor *self = ObjectWrap::Unwrap<TableCursor>(env, cursor);
+  assert(self != nullptr);
+
+  napi_create_reference(env, function->handle(), 1, &self->functionObject);
+  self->sharedHandle = sharedHandle;
+  self->sharedHandle->Ref();
+  self->tableHandle = tableHandle;
+  self->typePlan = field.typePlan;
+  self->rowCount = rowCount;
+  self->batchSize = batchSize;
+  self->options = options;
+
+  return cursor;
+}
+
+NAPI_METHOD(TableCursor::New)
+{
+  CallbackInfo info(env, cbinfo);
+
+  if (!info.IsConstructCall()) {
+    return ThrowError(env, "Invalid call format. Please use the 'new' operator.");
+  }
+
+  TableCursor *self = new TableCursor();
+  self->Wrap(env, info.This());
+
+  return info.This();
+}
+
+/**
+ * Returns the next batch of rows as an array, or null when the table is exhausted
+ */
+NAPI_METHOD(TableCursor::Next)
+{
+  CallbackInfo info(env, cbinfo);
+  TableCursor *self = ObjectWrap::Unwrap<TableCursor>(env, info.This());
+  assert(self != nullptr);
+
+  if (info.Length() > 0 && !IsUint32(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be a positive integer");
+  }
+
+  if (self->sharedHandle == nullptr || self->position >= self->rowCount) {
+    self->Release();
+    return Null(env);
+  }
+
+  unsigned int count = info.Length() > 0 ? Uint32Value(env, info[0]) : self->batchSize;
+  if (count == 0 || count > self->rowCount - self->position) {
+    count = self->rowCount - self->position;
+  }
+
+  assert(self->typePlan);
+  RFC_ERROR_INFO errorInfo;
+  // Released once the batch has been converted
+  Arena arena;
+  NativeTable batch(*self->typePlan, arena, self->options);
+
+  if (!batch.Decode(self->tableHandle, self->position, count, &errorInfo)) {
+    self->Release();
+    RETURN_RFC_ERROR(errorInfo);
+  }
+
+  napi_value rows = batch.ToJS(env);
+  if (IsException(env, rows)) {
+    self->Release();
+  } else {
+    self->position += count;
+  }
+
+  return rows;
+}
+
+NAPI_METHOD(TableCursor::RowCount)
+{
+  CallbackInfo info(env, cbinfo);
+  TableCursor *self = ObjectWrap::Unwrap<TableCursor>(env, info.This());
+  assert(self != nullptr);
+
+  return Uint32(env, self->rowCount);
+}
+
+NAPI_METHOD(TableCursor::Close)
+{
+  CallbackInfo info(env, cbinfo);
+  TableCursor *self = ObjectWrap::Unwrap<TableCursor>(env, info.This());
+  assert(self != nullptr);
+
+  self->Release();
+
+  return nullptr;
+}
+
+void TableCursor::Release(void)
+{
+  if (this->sharedHandle != nullptr) {
+    this->sharedHandle->Unref();
+    this->sharedHandle = nullptr;
+  }
+  this->tableHandle = nullptr;
+  this->typePlan = nullptr;
+  if (this->functionObject != nullptr) {
+    napi_delete_reference(this->env, this->functionObject);
+    this->functionObject = nullptr;
+  }
+}
@@ -0,0 +1,102 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef TABLECURSOR_H_
+#define TABLECURSOR_H_
+
+#include "Common.h"
+#include "ObjectWrap.h"
+#include <sapnwrfc.h>
+#include "FunctionPlan.h"
+#include "NativeValue.h"
+
+class Function;
+
+/**
+ * Function handle of an invocation, shared by the table cursors that read
+ * from it. Destroyed together with the last cursor.
+ */
+class SharedFunctionHandle
+{
+  public:
+  SharedFunctionHandle(RFC_FUNCTION_HANDLE functionHandle) : functionHandle(functionHandle), refs(1) { };
+
+  void Ref() {
+    this->refs++;
+  };
+
+  void Unref() {
+    RFC_ERROR_INFO errorInfo;
+
+    if (--this->refs == 0) {
+      RfcDestroyFunction(this->functionHandle, &errorInfo);
+      delete this;
+    }
+  };
+
+  RFC_FUNCTION_HANDLE functionHandle;
+
+  private:
+  ~SharedFunctionHandle() { };
+
+  // Only used on the main thread
+  unsigned int refs;
+};
+
+/**
+ * Reads the rows of a result table in batches, so that large tables can be
+ * converted over several turns of the event loop.
+ */
+class TableCursor : public ObjectWrap
+{
+  public:
+  static void Init(napi_env env, napi_value exports);
+  static napi_value NewInstance(Function *function, SharedFunctionHandle *sharedHandle,
+                                const FieldPlan &field, unsigned int batchSize,
+                                const DecodeOptions &options);
+
+  protected:
+  TableCursor();
+  ~TableCursor();
+
+  static NAPI_METHOD(New);
+  static NAPI_METHOD(Next);
+  static NAPI_METHOD(RowCount);
+  static NAPI_METHOD(Close);
+
+  void Release(void);
+
+
+  // Keeps the function and therefore the type plan alive
+  napi_ref functionObject;
+  SharedFunctionHandle *sharedHandle;
+  RFC_TABLE_HANDLE tableHandle;
+  const TypePlan *typePlan;
+  unsigned int rowCount;
+  unsigned int position;
+  unsigned int batchSize;
+  DecodeOptions options;
+};
+
+#endif /* TABLECURSOR_H_ */
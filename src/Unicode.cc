@@ -0,0 +1,355 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Unicode.h"
+#include <uv.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UNICODE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(UNICODE_SSE2) && (defined(__x86_64__) || defined(_M_X64)) && \
+    (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define UNICODE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#define REPLACEMENT_CHARACTER 0xFFFD
+
+typedef size_t (*ToUTF8Func)(const SAP_UC *src, size_t length, char *dst);
+typedef bool (*IsLatin1Func)(const SAP_UC *src, size_t length);
+typedef void (*ToLatin1Func)(const SAP_UC *src, size_t length, uint8_t *dst);
+typedef size_t (*TrimmedLengthFunc)(const SAP_UC *src, size_t length);
+
+static uv_once_t initOnce = UV_ONCE_INIT;
+static ToUTF8Func toUTF8;
+static IsLatin1Func isLatin1;
+static ToLatin1Func toLatin1;
+static TrimmedLengthFunc trimmedLength;
+
+/**
+ * Encodes the code point starting at src[i] and advances i, unpaired
+ * surrogates become U+FFFD
+ */
+static inline size_t EncodeScalar(const SAP_UC *src, size_t &i, size_t length, char *dst)
+{
+  uint32_t c = static_cast<uint16_t>(src[i++]);
+
+  if (c < 0x80) {
+    dst[0] = static_cast<char>(c);
+    return 1;
+  }
+  if (c < 0x800) {
+    dst[0] = static_cast<char>(0xC0 | (c >> 6));
+    dst[1] = static_cast<char>(0x80 | (c & 0x3F));
+    return 2;
+  }
+  if (c >= 0xD800 && c <= 0xDFFF) {
+    uint32_t low = i < length ? static_cast<uint16_t>(src[i]) : 0;
+    if (c <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+      i++;
+      c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+      dst[0] = static_cast<char>(0xF0 | (c >> 18));
+      dst[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+      dst[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      dst[3] = static_cast<char>(0x80 | (c & 0x3F));
+      return 4;
+    }
+    c = REPLACEMENT_CHARACTER;
+  }
+  dst[0] = static_cast<char>(0xE0 | (c >> 12));
+  dst[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+  dst[2] = static_cast<char>(0x80 | (c & 0x3F));
+  return 3;
+}
+
+static size_t ToUTF8Scalar(const SAP_UC *src, size_t length, char *dst)
+{
+  size_t i = 0, out = 0;
+
+  while (i < length) {
+    out += EncodeScalar(src, i, length, dst + out);
+  }
+
+  return out;
+}
+
+static bool IsLatin1Scalar(const SAP_UC *src, size_t length)
+{
+  for (size_t i = 0; i < length; i++) {
+    if (static_cast<uint16_t>(src[i]) > 0xFF) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void ToLatin1Scalar(const SAP_UC *src, size_t length, uint8_t *dst)
+{
+  for (size_t i = 0; i < length; i++) {
+    dst[i] = static_cast<uint8_t>(src[i]);
+  }
+}
+
+static size_t TrimmedLengthScalar(const SAP_UC *src, size_t length)
+{
+  while (length > 0 && src[length - 1] == 0x20) {
+    length--;
+  }
+
+  return length;
+}
+
+#ifdef UNICODE_SSE2
+
+// 16 code units per step, ASCII blocks are packed to bytes, others are encoded one by one
+static size_t ToUTF8SSE2(const SAP_UC *src, size_t length, char *dst)
+{
+  const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+  size_t i = 0, out = 0;
+
+  while (i + 16 <= length) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+    __m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xFFFF) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + out), _mm_packus_epi16(a, b));
+      i += 16;
+      out += 16;
+    } else {
+      size_t end = i + 16;
+      while (i < end) {
+        out += EncodeScalar(src, i, length, dst + out);
+      }
+    }
+  }
+
+  while (i < length) {
+    out += EncodeScalar(src, i, length, dst + out);
+  }
+
+  return out;
+}
+
+static bool IsLatin1SSE2(const SAP_UC *src, size_t length)
+{
+  const __m128i nonLatin1 = _mm_set1_epi16(static_cast<short>(0xFF00));
+  __m128i high = _mm_setzero_si128();
+  size_t i = 0;
+
+  for (; i + 8 <= length; i += 8) {
+    high = _mm_or_si128(high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+  }
+  high = _mm_and_si128(high, nonLatin1);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF) {
+    return false;
+  }
+
+  return IsLatin1Scalar(src + i, length - i);
+}
+
+static void ToLatin1SSE2(const SAP_UC *src, size_t length, uint8_t *dst)
+{
+  size_t i = 0;
+
+  // Both halves are loaded before storing, so dst may alias src
+  for (; i + 16 <= length; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+  }
+
+  ToLatin1Scalar(src + i, length - i, dst + i);
+}
+
+static size_t TrimmedLengthSSE2(const SAP_UC *src, size_t length)
+{
+  const __m128i blanks = _mm_set1_epi16(0x20);
+
+  while (length >= 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + length - 8));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, blanks)) != 0xFFFF) {
+      break;
+    }
+    length -= 8;
+  }
+
+  return TrimmedLengthScalar(src, length);
+}
+
+#endif /* UNICODE_SSE2 */
+
+#ifdef UNICODE_AVX2
+
+TARGET_AVX2 static size_t ToUTF8AVX2(const SAP_UC *src, size_t length, char *dst)
+{
+  const __m256i nonAscii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+  size_t i = 0, out = 0;
+
+  while (i + 32 <= length) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+
+    if (_mm256_testz_si256(_mm256_or_si256(a, b), nonAscii)) {
+      // packus works per 128 bit lane, restore the order of the quadwords
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + out), packed);
+      i += 32;
+      out += 32;
+    } else {
+      size_t end = i + 32;
+      while (i < end) {
+        out += EncodeScalar(src, i, length, dst + out);
+      }
+    }
+  }
+
+  return out + ToUTF8SSE2(src + i, length - i, dst + out);
+}
+
+TARGET_AVX2 static bool IsLatin1AVX2(const SAP_UC *src, size_t length)
+{
+  const __m256i nonLatin1 = _mm256_set1_epi16(static_cast<short>(0xFF00));
+  __m256i high = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 16) {
+    high = _mm256_or_si256(high, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+  }
+  if (!_mm256_testz_si256(high, nonLatin1)) {
+    return false;
+  }
+
+  return IsLatin1SSE2(src + i, length - i);
+}
+
+TARGET_AVX2 static void ToLatin1AVX2(const SAP_UC *src, size_t length, uint8_t *dst)
+{
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+  }
+
+  ToLatin1SSE2(src + i, length - i, dst + i);
+}
+
+TARGET_AVX2 static size_t TrimmedLengthAVX2(const SAP_UC *src, size_t length)
+{
+  const __m256i blanks = _mm256_set1_epi16(0x20);
+
+  while (length >= 16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + length - 16));
+    if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, blanks))) != 0xFFFFFFFFu) {
+      break;
+    }
+    length -= 16;
+  }
+
+  return TrimmedLengthSSE2(src, length);
+}
+
+static bool HasAVX2(void)
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  // AVX and OSXSAVE, and the OS saves the YMM registers
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif /* UNICODE_AVX2 */
+
+static void SelectImplementation(void)
+{
+  toUTF8 = ToUTF8Scalar;
+  isLatin1 = IsLatin1Scalar;
+  toLatin1 = ToLatin1Scalar;
+  trimmedLength = TrimmedLengthScalar;
+
+#ifdef UNICODE_SSE2
+  toUTF8 = ToUTF8SSE2;
+  isLatin1 = IsLatin1SSE2;
+  toLatin1 = ToLatin1SSE2;
+  trimmedLength = TrimmedLengthSSE2;
+#endif
+
+#ifdef UNICODE_AVX2
+  if (HasAVX2()) {
+    toUTF8 = ToUTF8AVX2;
+    isLatin1 = IsLatin1AVX2;
+    toLatin1 = ToLatin1AVX2;
+    trimmedLength = TrimmedLengthAVX2;
+  }
+#endif
+}
+
+void Unicode::Init(void)
+{
+  uv_once(&initOnce, SelectImplementation);
+}
+
+size_t Unicode::ToUTF8(const SAP_UC *src, size_t length, char *dst)
+{
+  Init();
+  return toUTF8(src, length, dst);
+}
+
+bool Unicode::IsLatin1(const SAP_UC *src, size_t length)
+{
+  Init();
+  return isLatin1(src, length);
+}
+
+void Unicode::ToLatin1(const SAP_UC *src, size_t length, uint8_t *dst)
+{
+  Init();
+  toLatin1(src, length, dst);
+}
+
+size_t Unicode::TrimmedLength(const SAP_UC *src, size_t length)
+{
+  Init();
+  return trimmedLength(src, length);
+}
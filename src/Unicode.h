@@ -0,0 +1,55 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef UNICODE_H_
+#define UNICODE_H_
+
+#include <sapnwrfc.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Conversions of SAP_UC (UTF-16) strings, vectorized with SSE2 or AVX2 where
+ * the CPU supports it. The implementation is picked once at runtime, all
+ * functions are thread safe and do not touch V8.
+ */
+class Unicode
+{
+  public:
+  // dst must hold 3 * length bytes, returns the number of bytes written
+  static size_t ToUTF8(const SAP_UC *src, size_t length, char *dst);
+
+  // True if all code units fit into one byte
+  static bool IsLatin1(const SAP_UC *src, size_t length);
+  // Narrows a Latin-1 string, dst may be the same memory as src
+  static void ToLatin1(const SAP_UC *src, size_t length, uint8_t *dst);
+
+  // Length without trailing blanks, as used to pad CHAR fields
+  static size_t TrimmedLength(const SAP_UC *src, size_t length);
+
+  protected:
+  static void Init(void);
+};
+
+#endif /* UNICODE_H_ */
@@ -0,0 +1,346 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#include "Common.h"
+#include "WorkerPool.h"
+#include "AddonState.h"
+
+static uv_once_t poolMutexOnce = UV_ONCE_INIT;
+
+unsigned int WorkerPool::size = DEFAULT_WORKER_POOL_SIZE;
+size_t WorkerPool::stackSize = 0;
+bool WorkerPool::affinity = false;
+bool WorkerPool::started = false;
+std::vector<WorkerPool::Worker*> WorkerPool::workers;
+std::deque<WorkerPool::Task> WorkerPool::tasks;
+unsigned int WorkerPool::busy = 0;
+uv_mutex_t WorkerPool::poolMutex;
+uv_cond_t WorkerPool::poolCondition;
+
+void WorkerPool::Init(napi_env env, napi_value exports)
+{
+  uv_once(&poolMutexOnce, WorkerPool::InitMutex);
+
+  napi_property_descriptor methods[] = {
+    Method("Configure", WorkerPool::Configure),
+    Method("Stats", WorkerPool::Stats)
+  };
+
+  napi_value pool = NewObject(env);
+  napi_define_properties(env, pool, sizeof(methods) / sizeof(methods[0]), methods);
+
+  Set(env, exports, "WorkerPool", pool);
+}
+
+void WorkerPool::InitMutex(void)
+{
+  uv_mutex_init(&poolMutex);
+  uv_cond_init(&poolCondition);
+}
+
+/**
+ * Configure({ size, stackSize, affinity }), only before the first RFC work has been queued
+ */
+NAPI_METHOD(WorkerPool::Configure)
+{
+  CallbackInfo info(env, cbinfo);
+
+  if (info.Length() != 1 || !IsObject(env, info[0])) {
+    return ThrowError(env, "Argument 1 must be an object");
+  }
+  napi_value options = info[0];
+
+  unsigned int newSize = 0;
+  napi_value value = Get(env, options, "size");
+  if (!IsUndefined(env, value)) {
+    if (!IsUint32(env, value) || Uint32Value(env, value) == 0) {
+      return ThrowError(env, "Option size must be a positive integer");
+    }
+    newSize = Uint32Value(env, value);
+  }
+
+  bool hasStackSize = false;
+  size_t newStackSize = 0;
+  value = Get(env, options, "stackSize");
+  if (!IsUndefined(env, value)) {
+    if (!IsUint32(env, value)) {
+      return ThrowError(env, "Option stackSize must be a number of bytes");
+    }
+    hasStackSize = true;
+    newStackSize = Uint32Value(env, value);
+  }
+
+  napi_value newAffinity = Get(env, options, "affinity");
+
+  uv_mutex_lock(&poolMutex);
+  bool running = started;
+  if (!running) {
+    if (newSize > 0) {
+      size = newSize;
+    }
+    if (hasStackSize) {
+      stackSize = newStackSize;
+    }
+    if (!IsUndefined(env, newAffinity)) {
+      affinity = BooleanValue(env, newAffinity);
+    }
+  }
+  uv_mutex_unlock(&poolMutex);
+
+  if (running) {
+    return ThrowError(env, "Worker pool is already running");
+  }
+
+  return Boolean(env, true);
+}
+
+/**
+ * @return Object with the number of threads, busy threads and tasks of this isolate not completed yet
+ */
+NAPI_METHOD(WorkerPool::Stats)
+{
+  uv_mutex_lock(&poolMutex);
+  unsigned int threads = size;
+  unsigned int running = busy;
+  uv_mutex_unlock(&poolMutex);
+
+  napi_value stats = NewObject(env);
+  Set(env, stats, "size", Uint32(env, threads));
+  Set(env, stats, "busy", Uint32(env, running));
+  Set(env, stats, "pending", Uint32(env, AddonState::Current()->sink->pending));
+
+  return stats;
+}
+
+WorkerPool::Sink* WorkerPool::NewSink(napi_env env)
+{
+  Sink *sink = new Sink();
+  uv_loop_t *loop = nullptr;
+
+  napi_get_uv_event_loop(env, &loop);
+  uv_async_init(loop, &sink->signal, AfterRun);
+  sink->signal.data = sink;
+  uv_unref(reinterpret_cast<uv_handle_t*>(&sink->signal));
+
+  return sink;
+}
+
+/**
+ * Tasks still running for the sink complete without their after work callbacks
+ */
+void WorkerPool::CloseSink(Sink *sink)
+{
+  uv_mutex_lock(&poolMutex);
+  sink->closed = true;
+  sink->refs -= sink->done.size();
+  sink->done.clear();
+  uv_mutex_unlock(&poolMutex);
+
+  uv_close(reinterpret_cast<uv_handle_t*>(&sink->signal), AfterClose);
+}
+
+void WorkerPool::AfterClose(uv_handle_t *handle)
+{
+  Sink *sink = static_cast<Sink*>(handle->data);
+
+  uv_mutex_lock(&poolMutex);
+  bool unused = Release(sink);
+  uv_mutex_unlock(&poolMutex);
+
+  if (unused) {
+    delete sink;
+  }
+}
+
+bool WorkerPool::Release(Sink *sink)
+{
+  return --sink->refs == 0;
+}
+
+void WorkerPool::Queue(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork, int affinity)
+{
+  Sink *sink = AddonState::Current()->sink;
+
+  // Keep the loop alive while work is outstanding
+  if (sink->pending++ == 0) {
+    uv_ref(reinterpret_cast<uv_handle_t*>(&sink->signal));
+  }
+
+  uv_mutex_lock(&poolMutex);
+  if (!started) {
+    Start();
+  }
+
+  sink->refs++;
+  if (WorkerPool::affinity && affinity >= 0) {
+    workers[affinity % workers.size()]->tasks.push_back(Task(req, work, afterWork, sink));
+    uv_cond_broadcast(&poolCondition);
+  } else {
+    tasks.push_back(Task(req, work, afterWork, sink));
+    uv_cond_signal(&poolCondition);
+  }
+  uv_mutex_unlock(&poolMutex);
+}
+
+/**
+ * The after work callback of a cancelled task runs with UV_ECANCELED
+ */
+bool WorkerPool::Cancel(uv_work_t *req)
+{
+  Task task;
+
+  uv_mutex_lock(&poolMutex);
+  bool found = Remove(tasks, req, task);
+  for (unsigned int i = 0; !found && i < workers.size(); i++) {
+    found = Remove(workers[i]->tasks, req, task);
+  }
+  if (found) {
+    task.status = UV_ECANCELED;
+    task.sink->done.push_back(task);
+    uv_async_send(&task.sink->signal);
+  }
+  uv_mutex_unlock(&poolMutex);
+
+  return found;
+}
+
+void WorkerPool::Complete(uv_work_t *req, uv_after_work_cb afterWork, int status)
+{
+  Sink *sink = AddonState::Current()->sink;
+  Task task(req, nullptr, afterWork, sink);
+  task.status = status;
+
+  if (sink->pending++ == 0) {
+    uv_ref(reinterpret_cast<uv_handle_t*>(&sink->signal));
+  }
+
+  uv_mutex_lock(&poolMutex);
+  sink->refs++;
+  sink->done.push_back(task);
+  uv_async_send(&sink->signal);
+  uv_mutex_unlock(&poolMutex);
+}
+
+/**
+ * Starts the threads, with poolMutex held
+ */
+void WorkerPool::Start(void)
+{
+  for (unsigned int i = 0; i < size; i++) {
+    Worker *worker = new Worker();
+    worker->index = i;
+    workers.push_back(worker);
+
+#if UV_VERSION_HEX >= 0x011a00
+    uv_thread_options_t options;
+    options.flags = stackSize > 0 ? UV_THREAD_HAS_STACK_SIZE : UV_THREAD_NO_FLAGS;
+    options.stack_size = stackSize;
+    uv_thread_create_ex(&worker->thread, &options, Run, worker);
+#else
+    uv_thread_create(&worker->thread, Run, worker);
+#endif
+  }
+
+  started = true;
+}
+
+bool WorkerPool::Take(Worker *worker, Task &task)
+{
+  std::deque<Task> &queue = !worker->tasks.empty() ? worker->tasks : tasks;
+  if (queue.empty()) {
+    return false;
+  }
+
+  task = queue.front();
+  queue.pop_front();
+  return true;
+}
+
+bool WorkerPool::Remove(std::deque<Task> &queue, uv_work_t *req, Task &task)
+{
+  for (std::deque<Task>::iterator it = queue.begin(); it != queue.end(); ++it) {
+    if (it->req == req) {
+      task = *it;
+      queue.erase(it);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void WorkerPool::Run(void *arg)
+{
+  Worker *worker = static_cast<Worker*>(arg);
+  Task task;
+
+  for (;;) {
+    uv_mutex_lock(&poolMutex);
+    while (!Take(worker, task)) {
+      uv_cond_wait(&poolCondition, &poolMutex);
+    }
+    busy++;
+    uv_mutex_unlock(&poolMutex);
+
+    task.work(task.req);
+
+    uv_mutex_lock(&poolMutex);
+    busy--;
+    bool unused = false;
+    if (task.sink->closed) {
+      // The isolate is gone, nobody is left to run the after work callback
+      unused = Release(task.sink);
+    } else {
+      task.sink->done.push_back(task);
+      uv_async_send(&task.sink->signal);
+    }
+    uv_mutex_unlock(&poolMutex);
+
+    if (unused) {
+      delete task.sink;
+    }
+  }
+}
+
+/**
+ * Runs the after work callbacks of all completed tasks, on the thread of the isolate
+ */
+void WorkerPool::AfterRun(uv_async_t *handle)
+{
+  Sink *sink = static_cast<Sink*>(handle->data);
+  std::deque<Task> completed;
+
+  uv_mutex_lock(&poolMutex);
+  completed.swap(sink->done);
+  sink->refs -= completed.size();
+  uv_mutex_unlock(&poolMutex);
+
+  for (unsigned int i = 0; i < completed.size(); i++) {
+    completed[i].afterWork(completed[i].req, completed[i].status);
+
+    if (--sink->pending == 0) {
+      uv_unref(reinterpret_cast<uv_handle_t*>(&sink->signal));
+    }
+  }
+}
@@ -0,0 +1,131 @@
+/*
+-----------------------------------------------------------------------------
+Copyright (c) 2011 Joachim Dorner
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+-----------------------------------------------------------------------------
+*/
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include "Common.h"
+#include <uv.h>
+#include <deque>
+#include <vector>
+
+#define DEFAULT_WORKER_POOL_SIZE 4
+
+/**
+ * Threads of the addon which run all RFC work, so that long running calls do
+ * not occupy the libuv thread pool shared with fs, crypto and zlib. The
+ * threads are shared by all isolates, results are handed back to the loop of
+ * the queueing isolate through its sink. Queue and the JavaScript methods must
+ * be called on the thread of an isolate.
+ */
+class WorkerPool
+{
+  public:
+
+    class Task;
+    class Sink;
+
+    static void Init(napi_env env, napi_value exports);
+
+    // Like uv_queue_work, tasks with the same affinity run on the same thread if enabled
+    static void Queue(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork, int affinity = -1);
+    // Takes a task out of the queue before it has started, returns false if it is running or done
+    static bool Cancel(uv_work_t *req);
+    // Runs the after work callback of work that never reached the pool on the next turn of the loop
+    static void Complete(uv_work_t *req, uv_after_work_cb afterWork, int status);
+
+    // One per isolate, created and closed on its thread
+    static Sink* NewSink(napi_env env);
+    static void CloseSink(Sink *sink);
+
+    class Task
+    {
+      public:
+      Task() : req(nullptr), work(nullptr), afterWork(nullptr), sink(nullptr), status(0) { };
+      Task(uv_work_t *req, uv_work_cb work, uv_after_work_cb afterWork, Sink *sink) :
+        req(req), work(work), afterWork(afterWork), sink(sink), status(0) { };
+
+      uv_work_t *req;
+      uv_work_cb work;
+      uv_after_work_cb afterWork;
+      Sink *sink;
+      // Passed to the after work callback, UV_ECANCELED if the work did not run
+      int status;
+    };
+
+    class Sink
+    {
+      public:
+      Sink() : pending(0), refs(1), closed(false) { };
+
+      uv_async_t signal;
+      // Thread of the isolate only
+      unsigned int pending;
+      // Guarded by poolMutex, the signal handle and every queued task hold a reference
+      std::deque<Task> done;
+      unsigned int refs;
+      bool closed;
+    };
+
+  protected:
+
+    static NAPI_METHOD(Configure);
+    static NAPI_METHOD(Stats);
+
+    static void InitMutex(void);
+    static void Start(void);
+    static void Run(void *arg);
+    static void AfterRun(uv_async_t *handle);
+    static void AfterClose(uv_handle_t *handle);
+
+    class Worker
+    {
+      public:
+      Worker() : index(0) { };
+
+      uv_thread_t thread;
+      unsigned int index;
+      // Tasks bound to this thread
+      std::deque<Task> tasks;
+    };
+
+    // With poolMutex held
+    static bool Take(Worker *worker, Task &task);
+    static bool Remove(std::deque<Task> &queue, uv_work_t *req, Task &task);
+    static bool Release(Sink *sink);
+
+    // Guarded by poolMutex, settings are fixed once the threads have been started
+    static unsigned int size;
+    static size_t stackSize;
+    static bool affinity;
+    static bool started;
+    static std::vector<Worker*> workers;
+    static std::deque<Task> tasks;
+    static unsigned int busy;
+
+    static uv_mutex_t poolMutex;
+    static uv_cond_t poolCondition;
+};
+
+#endif /* WORKERPOOL_H_ */
@@ -22,16 +22,26 @@ SOFTWARE.
 -----------------------------------------------------------------------------
 */
 
-#include <v8.h>
-#include <node.h>
-
+#include "AddonState.h"
 #include "Connection.h"
+#include "ConnectionPool.h"
 #include "Function.h"
+#include "MetadataCache.h"
+#include "TableCursor.h"
+#include "WorkerPool.h"
 
-NAN_MODULE_INIT(init)
+// Context aware, so that worker threads may load the module as well
+NAPI_MODULE_INIT()
 {
-  Connection::Init(target);
-  Function::Init(target);
-}
+  // Everything below keeps its per environment state here
+  AddonState::Create(env);
 
-NODE_MODULE(sapnwrfc, init);
+  Connection::Init(env, exports);
+  ConnectionPool::Init(env, exports);
+  Function::Init(env, exports);
+  MetadataCache::Init(env, exports);
+  TableCursor::Init(env, exports);
+  WorkerPool::Init(env, exports);
+
+  return exports;
+}
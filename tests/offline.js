@@ -1,4 +1,4 @@
-/* global describe, before, it, context */
+/* global describe, before, after, it, context */
 var mocha = require('mocha');
 var should = require('should');
 var sapnwrfc = require('../sapnwrfc');
@@ -34,6 +34,10 @@ describe('Offline tests [ci]', function () {
     it('should still be closed', function () {
       con.IsOpen().should.be.false();
     });
+
+    it('should have an empty queue', function () {
+      con.QueueStats().should.have.properties({ running: 0, pending: 0, high: 0, normal: 0, low: 0 });
+    });
   });
 
   context('Closed connection', function () {
@@ -42,6 +46,151 @@ describe('Offline tests [ci]', function () {
       pong.should.be.an.Error();
       should(pong.key).equal('RFC_INVALID_HANDLE');
     });
+
+    it('should fail on asynchronous ping', function (done) {
+      con.Ping(function (err) {
+        err.should.be.an.Error();
+        should(err.key).equal('RFC_INVALID_HANDLE');
+        done();
+      });
+    });
+
+    it('should not be open asynchronously', function (done) {
+      con.IsOpen(function (err, isOpen) {
+        should(err).be.Null();
+        isOpen.should.be.false();
+        done();
+      });
+    });
+  });
+
+  context('Metadata cache', function () {
+    it('should report its size', function () {
+      sapnwrfc.MetadataCache.Size().should.be.a.Number();
+    });
+
+    it('should invalidate all entries', function () {
+      sapnwrfc.MetadataCache.Invalidate().should.be.a.Number();
+      sapnwrfc.MetadataCache.Size().should.equal(0);
+    });
+  });
+
+  context('Invocation options', function () {
+    var func = undefined;
+
+    before(function () {
+      func = new sapnwrfc.Function;
+    });
+
+    it('should reject an unknown table mode', function () {
+      (function () {
+        func.Invoke({}, { tables: 'foo' }, function () {});
+      }).should.throw(/tables/);
+    });
+
+    it('should reject an invalid batch size', function () {
+      (function () {
+        func.Invoke({}, { tables: 'stream', batchSize: 0 }, function () {});
+      }).should.throw(/batchSize/);
+    });
+
+    it('should reject an unknown decimal mode', function () {
+      (function () {
+        func.Invoke({}, { decimals: 'float' }, function () {});
+      }).should.throw(/decimals/);
+    });
+
+    it('should only accept an array for batches', function () {
+      (function () {
+        func.InvokeBatch({}, function () {});
+      }).should.throw(/array/);
+    });
+
+    it('should reject an unknown priority', function () {
+      (function () {
+        func.Invoke({}, { priority: 'urgent' }, function () {});
+      }).should.throw(/priority/);
+    });
+
+    it('should validate the options of promised invocations', function () {
+      (function () {
+        func.InvokeAsync({}, { tables: 'foo' });
+      }).should.throw(/tables/);
+    });
+
+    it('should not stream tables in batches', function () {
+      (function () {
+        func.InvokeBatch([], { tables: 'stream' }, function () {});
+      }).should.throw(/stream/);
+    });
+
+    it('should reject an invalid timeout', function () {
+      (function () {
+        func.Invoke({}, { timeout: -1 }, function () {});
+      }).should.throw(/timeout/);
+    });
+
+    it('should reject a signal that is not an AbortSignal', function () {
+      (function () {
+        func.Invoke({}, { signal: {} }, function () {});
+      }).should.throw(/AbortSignal/);
+    });
+  });
+
+  context('Worker pool', function () {
+    it('should report its size', function () {
+      sapnwrfc.WorkerPool.Stats().should.have.property('size').which.is.above(0);
+    });
+
+    it('should load in a worker thread', function (done) {
+      var threads;
+      try {
+        threads = require('worker_threads');
+      } catch (e) {
+        return this.skip();
+      }
+
+      var worker = new threads.Worker(
+        "var sapnwrfc = require(" + JSON.stringify(require.resolve('../sapnwrfc')) + ");" +
+        "require('worker_threads').parentPort.postMessage(new sapnwrfc.Connection().IsOpen());",
+        { eval: true });
+      worker.on('message', function (isOpen) {
+        isOpen.should.be.false();
+        done();
+      });
+      worker.on('error', done);
+    });
+  });
+
+  context('Closed connection pool', function () {
+    var pool = undefined;
+
+    before(function () {
+      pool = new sapnwrfc.ConnectionPool;
+    });
+
+    it('should be empty', function () {
+      var stats = pool.Stats();
+      stats.should.be.an.Object();
+      stats.size.should.equal(0);
+      stats.busy.should.equal(0);
+    });
+
+    it('should fail on lookup', function () {
+      (function () {
+        pool.Lookup('RFC_PING');
+      }).should.throw(/closed/);
+    });
+
+    it('should not queue asynchronous lookups', function () {
+      var lookup = pool.LookupAsync('RFC_PING');
+      pool.Stats().waiting.should.equal(0);
+      return lookup.then(function () {
+        throw new Error('Lookup should have failed');
+      }, function (err) {
+        err.message.should.match(/closed/);
+      });
+    });
   });
 });
 
@@ -80,6 +229,59 @@ describe('Online tests', function () {
       func.should.not.be.an.Error();
       func.Invoke.should.be.an.Function;
     });
+
+    it('should lookup an existing FM asynchronously', function (done) {
+      con.LookupAsync('STFC_CONNECTION', function (err, func) {
+        should(err).be.Null();
+        func.Invoke.should.be.a.Function();
+        func.should.have.property('REQUTEXT');
+        done();
+      });
+    });
+
+    it('should return a promise of the looked up FM', function () {
+      return con.LookupAsync('STFC_CONNECTION').then(function (func) {
+        func.Invoke.should.be.a.Function();
+        func.should.have.property('REQUTEXT');
+      });
+    });
+
+    it('should reject the promise of a non-existing FM', function () {
+      return con.LookupAsync('AAAAAAAA').then(function () {
+        throw new Error('Lookup should have failed');
+      }, function (err) {
+        err.should.be.an.Error();
+        should(err.key).equal('FU_NOT_FOUND');
+      });
+    });
+
+    it('should fail on asynchronous lookup of a non-existing FM', function (done) {
+      con.LookupAsync('AAAAAAAA', function (err, func) {
+        err.should.be.an.Error();
+        should(err.key).equal('FU_NOT_FOUND');
+        should(func).be.Null();
+        done();
+      });
+    });
+
+    it('should prewarm the metadata cache', function (done) {
+      sapnwrfc.MetadataCache.Invalidate(null, 'STFC_STRUCTURE');
+      var size = sapnwrfc.MetadataCache.Size();
+
+      con.Prewarm(['STFC_STRUCTURE'], function (err) {
+        should(err).be.Null();
+        sapnwrfc.MetadataCache.Size().should.equal(size + 1);
+        done();
+      });
+    });
+
+    it('should fail on prewarming a non-existing FM', function (done) {
+      con.Prewarm(['AAAAAAAA'], function (err) {
+        err.should.be.an.Error();
+        should(err.key).equal('FU_NOT_FOUND');
+        done();
+      });
+    });
   });
 
   context('Simple function calls', function () {
@@ -109,6 +311,40 @@ describe('Online tests', function () {
       });
     });
 
+    it('should resolve a promise', function () {
+      var func = con.Lookup('STFC_CONNECTION');
+
+      return func.InvokeAsync({ REQUTEXT: 'Hello world!' }).then(function (result) {
+        result.should.have.property('ECHOTEXT').and.startWith('Hello world!');
+      });
+    });
+
+    it('should trim CHAR fields', function (done) {
+      var func = con.Lookup('STFC_CONNECTION');
+      var params = { REQUTEXT: 'Hello world!' };
+
+      func.Invoke(params, { rtrim: true }, function (err, result) {
+        should(err).be.Null();
+
+        result.should.have.property('ECHOTEXT').and.equal('Hello world!');
+        done();
+      });
+    });
+
+    it('should invoke a batch of calls', function (done) {
+      var func = con.Lookup('STFC_CONNECTION');
+      var batch = [{ REQUTEXT: 'one' }, { REQUTEXT: 'two' }];
+
+      func.InvokeBatch(batch, { rtrim: true }, function (err, results) {
+        should(err).be.Null();
+
+        results.should.have.length(2);
+        results[0].should.have.property('ECHOTEXT').and.equal('one');
+        results[1].should.have.property('ECHOTEXT').and.equal('two');
+        done();
+      });
+    });
+
     it('should return a structure', function (done) {
       var func = con.Lookup('STFC_STRUCTURE');
       var params = {
@@ -220,6 +456,173 @@ describe('Online tests', function () {
         done();
       });
     });
+
+    it('should stream tables in batches', function (done) {
+      var func = con.Lookup('STFC_STRUCTURE');
+      var params = { RFCTABLE: [{ RFCINT4: 1 }, { RFCINT4: 2 }, { RFCINT4: 3 }] };
+
+      func.Invoke(params, { tables: 'stream', batchSize: 2 }, function (err, result) {
+        should(err).be.Null();
+
+        result.should.have.property('ECHOSTRUCT').and.be.an.Object();
+        result.RFCTABLE.should.be.an.instanceof(sapnwrfc.TableStream);
+        result.RFCTABLE.rowCount.should.equal(4);
+
+        var batches = [];
+        result.RFCTABLE.on('data', function (rows) {
+          batches.push(rows.length);
+        });
+        result.RFCTABLE.on('end', function () {
+          batches.should.eql([2, 2]);
+          done();
+        });
+      });
+    });
+
+    it('should return tables as columns', function (done) {
+      var func = con.Lookup('STFC_STRUCTURE');
+      var params = { RFCTABLE: [{ RFCINT4: 1, RFCCHAR4: 'ABCD' }, { RFCINT4: 2, RFCCHAR4: 'EFGH' }] };
+
+      func.Invoke(params, { tables: 'columns' }, function (err, result) {
+        should(err).be.Null();
+
+        var table = result.RFCTABLE;
+        table.RFCINT4.should.be.an.instanceof(Int32Array).and.have.length(3);
+        table.RFCINT4[0].should.equal(1);
+        table.RFCFLOAT.should.be.an.instanceof(Float64Array);
+        table.RFCCHAR4.offsets.should.have.length(4);
+        table.RFCCHAR4.data.toString('utf8', table.RFCCHAR4.offsets[1], table.RFCCHAR4.offsets[2]).should.equal('EFGH');
+        done();
+      });
+    });
+  });
+
+  context('Timeouts', function () {
+    var other = undefined;
+
+    before(function (done) {
+      other = new sapnwrfc.Connection;
+      other.Open(connectionParams, done);
+    });
+
+    after(function () {
+      other.Close();
+    });
+
+    it('should cancel a running call', function (done) {
+      var func = other.Lookup('RFC_PING_AND_WAIT');
+      var start = Date.now();
+
+      func.Invoke({ SECONDS: 5 }, { timeout: 500 }, function (err) {
+        err.should.be.an.Error();
+        should(err.key).equal('RFC_TIMEOUT');
+        (Date.now() - start).should.be.below(4000);
+        done();
+      });
+    });
+
+    it('should fail a queued call without waiting for the running one', function (done) {
+      var func = other.Lookup('RFC_PING_AND_WAIT');
+      var running = true;
+
+      func.Invoke({ SECONDS: 2 }, function () {
+        running = false;
+        done();
+      });
+      func.Invoke({ SECONDS: 0 }, { timeout: 300 }, function (err) {
+        err.should.be.an.Error();
+        should(err.key).equal('RFC_TIMEOUT');
+        running.should.be.true();
+      });
+    });
+
+    it('should stop waiting for a pooled connection', function (done) {
+      var pool = new sapnwrfc.ConnectionPool;
+      pool.Open(connectionParams, { min: 1, max: 1 }, function (err) {
+        should(err).be.Null();
+        var func = pool.Lookup('RFC_PING_AND_WAIT');
+        var running = true;
+
+        func.Invoke({ SECONDS: 2 }, function () {
+          running = false;
+          pool.Close();
+          done();
+        });
+        func.Invoke({ SECONDS: 0 }, { timeout: 300 }, function (err) {
+          err.should.be.an.Error();
+          should(err.key).equal('RFC_TIMEOUT');
+          running.should.be.true();
+        });
+      });
+    });
+  });
+
+  context('Connection pool', function () {
+    var pool = undefined;
+
+    before(function (done) {
+      pool = new sapnwrfc.ConnectionPool;
+      pool.Open(connectionParams, { min: 1, max: 4 }, function (err) {
+        should(err).be.Null();
+        done();
+      });
+    });
+
+    after(function () {
+      pool.Close();
+    });
+
+    it('should open the minimum number of connections', function () {
+      pool.Stats().size.should.equal(1);
+    });
+
+    it('should run invocations in parallel', function (done) {
+      var func = pool.Lookup('STFC_CONNECTION');
+      var pending = 4;
+
+      for (var i = 0; i < 4; i++) {
+        func.Invoke({ REQUTEXT: 'Call ' + i }, function (err, result) {
+          should(err).be.Null();
+          result.should.have.property('ECHOTEXT').and.startWith('Call ');
+          if (--pending === 0) {
+            pool.Stats().size.should.be.above(1);
+            pool.Stats().busy.should.equal(0);
+            done();
+          }
+        });
+      }
+    });
+
+    it('should open again after Close', function (done) {
+      var other = new sapnwrfc.ConnectionPool;
+      other.Open(connectionParams, { min: 1, max: 1 }, function (err) {
+        should(err).be.Null();
+        other.Close();
+        other.Open(connectionParams, { min: 1, max: 1 }, function (err) {
+          should(err).be.Null();
+          other.Stats().size.should.equal(1);
+          other.Close();
+          done();
+        });
+      });
+    });
+
+    it('should not block the event loop on lookup', function (done) {
+      var other = new sapnwrfc.ConnectionPool;
+      other.Open(connectionParams, { min: 1, max: 1 }, function (err) {
+        should(err).be.Null();
+        var func = other.Lookup('RFC_PING_AND_WAIT');
+        func.Invoke({ SECONDS: 2 }, function () {
+          other.Close();
+          done();
+        });
+        setTimeout(function () {
+          (function () {
+            other.Lookup('RFC_PING');
+          }).should.throw(/idle/);
+        }, 500);
+      });
+    });
   });
 
   /*context('Load tests', function () {